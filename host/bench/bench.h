@@ -0,0 +1,23 @@
+#ifndef BENCH_INCLUDED
+#define BENCH_INCLUDED
+
+#include <stdio.h>
+#include <time.h>
+
+// wall clock seconds, independent of shim clock the scheduler runs on
+inline double benchSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec*1e-9;
+}
+
+inline void benchReport(const char *name, unsigned long operations, double seconds) {
+  printf("%-44s %10.1f ns/op\n", name, seconds*1e9/operations);
+}
+
+// keeps compiler from dropping computed value
+template<class T> inline void benchKeep(T const &value) {
+  __asm__ __volatile__("" : : "r,m"(value) : "memory");
+}
+
+#endif
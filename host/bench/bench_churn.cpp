@@ -0,0 +1,108 @@
+// add, remove and find with most slots taken, against linear slot and id
+// search of the loop before free list and id index
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <TimerTasks.h>
+#include <bench.h>
+
+#define SLOTS (250)
+#define LIVE  (200)
+#define ROUNDS (200000)
+
+static BasicTaskManager<SLOTS, MAX_TRIGGERS, byte> manager;
+
+static void idle(Task *task, byte trigger, TaskTime time) {
+}
+
+// old add and remove: first free slot, first slot with id
+struct LinearSlots {
+  Task queue[SLOTS];
+
+  Task* add(byte id) {
+    unsigned int i;
+    for(i=0;i<SLOTS;i++) {
+      if (queue[i].trigger) continue;
+      queue[i].id = id;
+      queue[i].trigger = TIME_TRIGGER;
+      return queue+i;
+    }
+    return NULL;
+  }
+  Task* find(byte id) {
+    unsigned int i;
+    for(i=0;i<SLOTS;i++) {
+      if (queue[i].trigger && queue[i].id==id) return queue+i;
+    }
+    return NULL;
+  }
+  void remove(byte id) {
+    Task *task = find(id);
+    if (task) task->clear();
+  }
+};
+
+static LinearSlots linear;
+
+// xorshift, ids churn in no particular order
+static unsigned long seed = 2463534242UL;
+
+static byte randomId() {
+  seed ^= seed << 13;
+  seed &= 0xFFFFFFFFUL;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  seed &= 0xFFFFFFFFUL;
+  return 1 + seed % LIVE;
+}
+
+static unsigned long rearms;
+
+static TimerTask timer;
+
+// one shot timer armed again from its callback
+static void onTimer(Task *task, byte handle) {
+  rearms++;
+  timer.start(task, handle, TASK_MS(1));
+}
+
+int main() {
+  unsigned long i;
+  byte id;
+  for(id=1;id<=LIVE;id++) manager.addTask(id, TIME_TRIGGER, TASK_MS(1000), idle, NULL);
+  for(id=1;id<=LIVE;id++) linear.add(id);
+
+  double start = benchSeconds();
+  for(i=0;i<ROUNDS;i++) {
+    id = randomId();
+    manager.removeTask(id);
+    manager.addTask(id, TIME_TRIGGER, TASK_MS(1000), idle, NULL);
+  }
+  benchReport("remove and add, 200 of 250 slots", ROUNDS, benchSeconds()-start);
+  start = benchSeconds();
+  for(i=0;i<ROUNDS;i++) {
+    id = randomId();
+    linear.remove(id);
+    linear.add(id);
+  }
+  benchReport("linear, remove and add, 200 of 250 slots", ROUNDS, benchSeconds()-start);
+
+  unsigned long found = 0;
+  start = benchSeconds();
+  for(i=0;i<ROUNDS;i++) found += manager.findTask(randomId())!=NULL;
+  benchReport("findTask, 200 of 250 slots", ROUNDS, benchSeconds()-start);
+  start = benchSeconds();
+  for(i=0;i<ROUNDS;i++) found += linear.find(randomId())!=NULL;
+  benchReport("linear, find, 200 of 250 slots", ROUNDS, benchSeconds()-start);
+  benchKeep(found);
+
+  // default TM, every slot a timer armed again from its callback
+  timer.init(onTimer);
+  for(id=1;id<=TASK_QUEUE_SIZE;id++) timer.start(id, id, TASK_MS(1));
+  start = benchSeconds();
+  for(i=0;i<ROUNDS/TASK_QUEUE_SIZE;i++) {
+    shimAdvanceMillis(1);
+    TM.loop();
+  }
+  benchReport("one shot timer armed from callback", rearms, benchSeconds()-start);
+  return 0;
+}
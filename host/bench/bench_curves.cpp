@@ -0,0 +1,58 @@
+// curve sweep ticks against linear sweep with easing computed in callback,
+// the way ramps were done before curves
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <TimerTasks.h>
+#include <math.h>
+#include <bench.h>
+
+#define STEPS (50000)
+
+static unsigned long sum;
+
+static void onCurve(Task *task, byte handle, unsigned short value, boolean last) {
+  sum += value;
+}
+
+// value is linear position 0..STEPS, shaped here per tick
+static void onSmoothstep(Task *task, byte handle, unsigned short value, boolean last) {
+  float x = (float)value/STEPS;
+  sum += (unsigned short)(1000*(3*x*x-2*x*x*x));
+}
+
+static void onGamma(Task *task, byte handle, unsigned short value, boolean last) {
+  float x = (float)value/STEPS;
+  sum += (unsigned short)(1000*powf(x, 2.2f));
+}
+
+static void run(const char *name, PeriodicTask *sweep, const unsigned short *curve) {
+  byte id;
+  for(id=1;id<=TASK_POOL_SIZE;id++) {
+    if (curve) {
+      sweep->start(id, id, 0, 1000, STEPS, TASK_MS(1), curve);
+    } else {
+      sweep->start(id, id, 0, STEPS, 1, TASK_MS(1));
+    }
+  }
+  unsigned long i;
+  double start = benchSeconds();
+  for(i=0;i<STEPS;i++) {
+    shimAdvanceMillis(1);
+    TM.loop();
+  }
+  benchReport(name, STEPS*TASK_POOL_SIZE, benchSeconds()-start);
+  for(id=1;id<=TASK_POOL_SIZE;id++) TM.removeTask(id);
+}
+
+int main() {
+  PeriodicTask curves, smoothsteps, gammas;
+  curves.init(onCurve);
+  smoothsteps.init(onSmoothstep);
+  gammas.init(onGamma);
+  run("tick, CurveSCurve in handler", &curves, CurveSCurve);
+  run("tick, smoothstep float in callback", &smoothsteps, NULL);
+  run("tick, CurveGamma in handler", &curves, CurveGamma);
+  run("tick, powf gamma in callback", &gammas, NULL);
+  benchKeep(sum);
+  return 0;
+}
@@ -0,0 +1,35 @@
+// cost of loop per dispatched task and of loop with nothing due
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <bench.h>
+
+static unsigned long runs;
+
+static void tick(Task *task, byte trigger, TaskTime time) {
+  runs++;
+  task->time += TASK_MS(1);
+}
+
+static void idle(Task *task, byte trigger, TaskTime time) {
+  runs++;
+}
+
+int main() {
+  byte id;
+  unsigned long i;
+  for(id=1;id<=TASK_QUEUE_SIZE;id++) TM.addTask(id, TIME_TRIGGER, TASK_MS(1), tick, NULL);
+  double start = benchSeconds();
+  for(i=0;i<100000;i++) {
+    shimAdvanceMillis(1);
+    TM.loop();
+  }
+  benchReport("dispatch, all tasks due each loop", runs, benchSeconds()-start);
+  for(id=1;id<=TASK_QUEUE_SIZE;id++) TM.removeTask(id);
+
+  for(id=1;id<=TASK_QUEUE_SIZE;id++) TM.addTask(id, TIME_TRIGGER, TASK_MS(1000000), idle, NULL);
+  start = benchSeconds();
+  for(i=0;i<1000000;i++) TM.loop();
+  benchReport("loop, no task due", i, benchSeconds()-start);
+  benchKeep(runs);
+  return 0;
+}
@@ -0,0 +1,106 @@
+// static against virtual dispatch of library handlers. built twice, with
+// TASK_STATIC_HANDLERS handlers have no vtable and only static dispatch is
+// measured
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <TimerTasks.h>
+#include <Triggers.h>
+#include <bench.h>
+
+#define LOOPS (200000)
+
+static unsigned long calls;
+
+static void onTimer(Task *task, byte handle) {
+  calls++;
+}
+
+static void onSweep(Task *task, byte handle, unsigned short value, boolean last) {
+  calls++;
+}
+
+static ResourceTrigger resource;
+
+// wait for resource again, keeping dispatch task was added with
+static void onCapture(Task *task, byte handle) {
+  calls++;
+  task->trigger = resource.trigger();
+}
+
+static TimerTask timer;
+static PeriodicTask sweep;
+static CaptureResource capture;
+
+static void removeAll() {
+  Task *task;
+  while ((task = TM.nextTask(NULL))) TM.removeTask(task->id);
+}
+
+// dispatch through handler pointer, what addTask with handler does
+static void makeVirtual() {
+#ifndef TASK_STATIC_HANDLERS
+  Task *task;
+  for(task=TM.nextTask(NULL);task;task=TM.nextTask(task)) {
+    task->setHandler((TaskHandler*)task->context);
+  }
+#endif
+}
+
+static void measure(const char *name, boolean virtualCall, boolean advance) {
+  char label[64];
+  if (virtualCall) makeVirtual();
+  calls = 0;
+  double start = benchSeconds();
+  unsigned long i;
+  for(i=0;i<LOOPS;i++) {
+    if (advance) shimAdvanceMillis(1);
+    TM.loop();
+  }
+  snprintf(label, sizeof(label), "%s, %s", name, virtualCall ? "virtual" : "static");
+  benchReport(label, calls, benchSeconds()-start);
+  benchKeep(calls);
+  removeAll();
+}
+
+static void timers(boolean virtualCall) {
+  byte id;
+  for(id=1;id<=TASK_POOL_SIZE;id++) timer.start(id, id, TASK_MS(1), TASK_MS(1), TIMER_FOREVER);
+  measure("TimerTask repeating", virtualCall, true);
+}
+
+static void sweeps(boolean virtualCall) {
+  byte id;
+  for(id=1;id<=TASK_POOL_SIZE;id++) sweep.start(id, id, 0, 0xFFFF, 1, TASK_MS(1));
+  measure("PeriodicTask sweep", virtualCall, true);
+}
+
+static void captures(boolean virtualCall) {
+  byte id;
+  for(id=1;id<=4;id++) capture.start(id, id);
+  measure("CaptureResource", virtualCall, false);
+}
+
+int main() {
+  timer.init(onTimer);
+  sweep.init(onSweep);
+  resource.init(0x02);
+  capture.init(&resource, onCapture);
+#ifdef TASK_STATIC_HANDLERS
+  const char *build = "static build";
+#else
+  const char *build = "virtual build";
+#endif
+  // vtable pointer is in each object, on avr vtables also take ram
+  printf("%s: sizeof TimerTask %u, PeriodicTask %u, CaptureResource %u\n", build,
+         (unsigned)sizeof(TimerTask), (unsigned)sizeof(PeriodicTask),
+         (unsigned)sizeof(CaptureResource));
+  timers(false);
+  sweeps(false);
+  captures(false);
+#ifndef TASK_STATIC_HANDLERS
+  timers(true);
+  sweeps(true);
+  captures(true);
+#endif
+  return 0;
+}
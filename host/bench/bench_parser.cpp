@@ -0,0 +1,41 @@
+// StringParser throughput on typical command lines
+#include <Arduino.h>
+#include <StringParser.h>
+#include <bench.h>
+
+// command, byte, signed int and long each
+static const char *lines[] = {
+  "s 12 34 5",
+  "p 3 0 25520",
+  "t 9 -1200 65000",
+  "w 200 -7 4000000000",
+};
+
+int main() {
+  byte buffer[80];
+  Parser.init(buffer);
+  unsigned long i;
+  unsigned long bytes = 0;
+  unsigned long sum = 0;
+  double start = benchSeconds();
+  for(i=0;i<4000000;i++) {
+    const char *line = lines[i&3];
+    byte length = strlen(line);
+    memcpy(buffer, line, length);
+    bytes += length;
+    Parser.reset(length);
+    sum += Parser.readChar();
+    Parser.skipWhitespace();
+    sum += Parser.readByte();
+    Parser.skipWhitespace();
+    sum += Parser.readSignedInt();
+    Parser.skipWhitespace();
+    sum += Parser.readLong();
+    sum += Parser.stringParsed();
+  }
+  double seconds = benchSeconds()-start;
+  benchReport("parse command line", i, seconds);
+  benchReport("parse, per byte", bytes, seconds);
+  benchKeep(sum);
+  return 0;
+}
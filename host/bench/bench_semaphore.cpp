@@ -0,0 +1,43 @@
+// permit handoffs through semaphore line with many competing tasks
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <Triggers.h>
+#include <bench.h>
+
+static SemaphoreTrigger semaphores[2];
+static CaptureSemaphore captures[2];
+static unsigned long handoffs;
+
+// handle is semaphore number
+static void onPermit(Task *task, byte handle) {
+  handoffs++;
+  semaphores[handle].release();
+  captures[handle].start(task, handle);
+}
+
+static void run(byte competitors, byte handle) {
+  char name[64];
+  byte i;
+  byte permits = semaphores[handle].available();
+  for(i=1;i<=competitors;i++) captures[handle].start(i, handle);
+  handoffs = 0;
+  double start = benchSeconds();
+  unsigned long loop;
+  for(loop=0;loop<20000;loop++) TM.loop();
+  snprintf(name, sizeof(name), "handoff, %d tasks, %d permits", competitors, permits);
+  benchReport(name, handoffs, benchSeconds()-start);
+  for(i=1;i<=competitors;i++) TM.removeTask(i);
+}
+
+int main() {
+  semaphores[0].init(0x02, 1);
+  semaphores[1].init(0x04, 4);
+  captures[0].init(&semaphores[0], onPermit);
+  captures[1].init(&semaphores[1], onPermit);
+  run(2, 0);
+  run(8, 0);
+  run(20, 0);
+  run(20, 1);
+  benchKeep(handoffs);
+  return 0;
+}
@@ -0,0 +1,40 @@
+// formatting cost of serial output tasks, shim serial only stores bytes
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <SerialTasks.h>
+#include <bench.h>
+
+static SerialResponseTask Response;
+
+int main() {
+  static byte buffer[64];
+  byte i;
+  for(i=0;i<sizeof(buffer);i++) buffer[i] = i*37;
+  SerialOutSemaphore.init(0x02);
+
+  // a line per response, semaphore is held 100 ms after it
+  unsigned long count;
+  double start = benchSeconds();
+  for(count=0;count<100000;count++) {
+    Response.start(1, count);
+    TM.loop();
+    shimAdvanceMillis(100);
+    TM.loop();
+  }
+  benchReport("response line", count, benchSeconds()-start);
+
+  // 64 bytes as decimals, 16 per packet
+  unsigned long bytes = 0;
+  start = benchSeconds();
+  for(count=0;count<20000;count++) {
+    PacketTask.start(1, buffer, 16, sizeof(buffer), TASK_MS(1));
+    while (TM.findTask(1)) {
+      TM.loop();
+      shimAdvanceMillis(1);
+    }
+    bytes += sizeof(buffer);
+  }
+  benchReport("packet send, per byte", bytes, benchSeconds()-start);
+  benchKeep(Serial.outputLength());
+  return 0;
+}
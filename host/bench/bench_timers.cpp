@@ -0,0 +1,96 @@
+// timer heap against linear scan of all slots, the loop before the heap.
+// each loop one of N tasks is due, then a loop with none due. task ids are
+// bytes, so N stops at 250 instead of 1000
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <bench.h>
+
+#define LOOPS (20000)
+
+static unsigned long runs;
+
+// each task due once every count ms, tasks a ms apart
+static void tick(Task *task, byte trigger, TaskTime time) {
+  runs++;
+  task->time += TASK_MS(*task->state<unsigned short>());
+}
+
+template<unsigned int N> void heap() {
+  static BasicTaskManager<N, MAX_TRIGGERS, byte> manager;
+  unsigned int i;
+  shimSetMicros(0);
+  for(i=1;i<=N;i++) {
+    Task *task = manager.addTask(i, TIME_TRIGGER, TASK_MS(i), tick, NULL);
+    *task->state<unsigned short>() = N;
+  }
+  char name[64];
+  runs = 0;
+  double start = benchSeconds();
+  for(i=0;i<LOOPS;i++) {
+    shimAdvanceMillis(1);
+    manager.loop();
+  }
+  snprintf(name, sizeof(name), "heap, N=%u, one due", N);
+  benchReport(name, LOOPS, benchSeconds()-start);
+  // all due again in a ms at earliest
+  start = benchSeconds();
+  for(i=0;i<LOOPS;i++) manager.loop();
+  snprintf(name, sizeof(name), "heap, N=%u, none due", N);
+  benchReport(name, LOOPS, benchSeconds()-start);
+  benchKeep(runs);
+}
+
+// loop as it was: every slot is matched against trigger and time
+template<unsigned int N> struct LinearScan {
+  Task queue[N];
+
+  void loop() {
+    TaskTime time = TASK_CLOCK();
+    byte trigger = TIME_TRIGGER;
+    unsigned int i;
+    for(i=0;i<N;i++) {
+      Task *current = queue + i;
+      if (current->trigger && current->matches(trigger, time)) {
+        current->function(current, trigger, time);
+      }
+    }
+  }
+};
+
+template<unsigned int N> void linear() {
+  static LinearScan<N> manager;
+  unsigned int i;
+  shimSetMicros(0);
+  for(i=0;i<N;i++) {
+    Task *task = manager.queue+i;
+    task->id = i+1;
+    task->trigger = TIME_TRIGGER;
+    task->time = TASK_MS(i+1);
+    task->setFunction(tick, NULL);
+    *task->state<unsigned short>() = N;
+  }
+  char name[64];
+  runs = 0;
+  double start = benchSeconds();
+  for(i=0;i<LOOPS;i++) {
+    shimAdvanceMillis(1);
+    manager.loop();
+  }
+  snprintf(name, sizeof(name), "linear scan, N=%u, one due", N);
+  benchReport(name, LOOPS, benchSeconds()-start);
+  start = benchSeconds();
+  for(i=0;i<LOOPS;i++) manager.loop();
+  snprintf(name, sizeof(name), "linear scan, N=%u, none due", N);
+  benchReport(name, LOOPS, benchSeconds()-start);
+  benchKeep(runs);
+}
+
+int main() {
+  linear<10>();
+  heap<10>();
+  linear<100>();
+  heap<100>();
+  linear<250>();
+  heap<250>();
+  return 0;
+}
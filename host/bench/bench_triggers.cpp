@@ -0,0 +1,39 @@
+// trigger polling and dispatch of tasks waiting for resources
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <Triggers.h>
+#include <bench.h>
+
+#define RESOURCES (4)
+
+static ResourceTrigger resources[RESOURCES];
+static CaptureResource captures[RESOURCES];
+static unsigned long captured;
+
+static void onCapture(Task *task, byte handle) {
+  captured++;
+  resources[handle].release();
+  // wait for resource again
+  captures[handle].start(task->id, handle);
+}
+
+int main() {
+  byte i;
+  for(i=0;i<RESOURCES;i++) {
+    resources[i].init(0x02<<i);
+    captures[i].init(&resources[i], onCapture);
+  }
+  // triggers polled while no task waits for them
+  unsigned long loops;
+  double start = benchSeconds();
+  for(loops=0;loops<1000000;loops++) TM.loop();
+  benchReport("loop, resource triggers without waiters", loops, benchSeconds()-start);
+
+  // each loop every resource is aquired by its waiter and released
+  for(i=0;i<RESOURCES;i++) captures[i].start(i+1, i);
+  start = benchSeconds();
+  for(loops=0;loops<250000;loops++) TM.loop();
+  benchReport("resource capture and release", captured, benchSeconds()-start);
+  benchKeep(captured);
+  return 0;
+}
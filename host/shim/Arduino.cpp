@@ -0,0 +1,141 @@
+#include <Arduino.h>
+
+// wider than both clocks, so millis wraps at its own range, not at micros/1000
+static uint64_t clockMicros = 0;
+
+unsigned long millis() {
+  return clockMicros/1000;
+}
+
+unsigned long micros() {
+  return clockMicros;
+}
+
+void shimSetMicros(unsigned long value) {
+  clockMicros = value;
+}
+
+void shimSetMillis(unsigned long value) {
+  clockMicros = (uint64_t)value*1000;
+}
+
+void shimAdvanceMicros(unsigned long delta) {
+  clockMicros += delta;
+}
+
+void shimAdvanceMillis(unsigned long delta) {
+  clockMicros += delta*1000;
+}
+
+ShimSerial::ShimSerial() : inHead(0), inTail(0), outLength(0) {
+}
+
+void ShimSerial::begin(unsigned long baud) {
+}
+
+int ShimSerial::available() {
+  return inTail-inHead;
+}
+
+int ShimSerial::read() {
+  if (inHead==inTail) return -1;
+  return (byte)in[inHead++];
+}
+
+size_t ShimSerial::write(byte value) {
+  // keeps last bytes once full, so long runs don't need clearOutput
+  if (outLength==SHIM_SERIAL_OUT_SIZE) outLength = 0;
+  out[outLength++] = value;
+  return 1;
+}
+
+size_t ShimSerial::print(const char *text) {
+  size_t count = 0;
+  for(;*text;text++) count += write(*text);
+  return count;
+}
+
+size_t ShimSerial::print(char value) {
+  return write(value);
+}
+
+size_t ShimSerial::printNumber(unsigned long value, int base, boolean negative) {
+  char digits[8*sizeof(unsigned long)+2];
+  char *digit = digits+sizeof(digits)-1;
+  *digit = 0;
+  do {
+    byte rest = value % base;
+    *--digit = rest<10 ? '0'+rest : 'A'+rest-10;
+    value /= base;
+  } while (value);
+  if (negative) *--digit = '-';
+  return print(digit);
+}
+
+size_t ShimSerial::print(int value, int base) {
+  return print((long)value, base);
+}
+
+size_t ShimSerial::print(unsigned int value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t ShimSerial::print(long value, int base) {
+  // like Arduino, only decimal shows sign
+  if (base==DEC && value<0) return printNumber(-(unsigned long)value, base, true);
+  return printNumber(value, base, false);
+}
+
+size_t ShimSerial::print(unsigned long value, int base) {
+  return printNumber(value, base, false);
+}
+
+size_t ShimSerial::println() {
+  return print("\r\n");
+}
+
+size_t ShimSerial::println(const char *text) {
+  return print(text) + println();
+}
+
+size_t ShimSerial::println(char value) {
+  return print(value) + println();
+}
+
+size_t ShimSerial::println(int value, int base) {
+  return print(value, base) + println();
+}
+
+size_t ShimSerial::println(unsigned int value, int base) {
+  return print(value, base) + println();
+}
+
+size_t ShimSerial::println(long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t ShimSerial::println(unsigned long value, int base) {
+  return print(value, base) + println();
+}
+
+void ShimSerial::input(const char *text) {
+  // drop consumed bytes before queueing more
+  memmove(in, in+inHead, inTail-inHead);
+  inTail -= inHead;
+  inHead = 0;
+  for(;*text && inTail<SHIM_SERIAL_IN_SIZE;text++) in[inTail++] = *text;
+}
+
+const char* ShimSerial::output() {
+  return out;
+}
+
+unsigned int ShimSerial::outputLength() {
+  return outLength;
+}
+
+void ShimSerial::clearOutput() {
+  outLength = 0;
+}
+
+ShimSerial Serial;
@@ -0,0 +1,72 @@
+#ifndef ARDUINO_SHIM_INCLUDED
+#define ARDUINO_SHIM_INCLUDED
+
+// stand in for Arduino.h, so libraries build and run on linux. clock only
+// moves when test moves it, serial reads from and writes to memory
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define DEC 10
+#define HEX 16
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const byte*)(address))
+#define pgm_read_word(address) (*(const unsigned short*)(address))
+
+// as wide as host long, TaskTime keeps 32 bits of them and wraps like on board
+unsigned long millis();
+unsigned long micros();
+// set clock, millis follows micros
+void shimSetMicros(unsigned long micros);
+void shimSetMillis(unsigned long millis);
+void shimAdvanceMicros(unsigned long delta);
+void shimAdvanceMillis(unsigned long delta);
+
+#define SHIM_SERIAL_IN_SIZE  (1024)
+#define SHIM_SERIAL_OUT_SIZE (65536)
+
+class ShimSerial {
+  char in[SHIM_SERIAL_IN_SIZE];
+  unsigned int inHead;
+  unsigned int inTail;
+  char out[SHIM_SERIAL_OUT_SIZE];
+  unsigned int outLength;
+
+  size_t printNumber(unsigned long value, int base, boolean negative);
+
+  public:
+    ShimSerial();
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    size_t write(byte value);
+    size_t print(const char *text);
+    size_t print(char value);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t println();
+    size_t println(const char *text);
+    size_t println(char value);
+    size_t println(int value, int base = DEC);
+    size_t println(unsigned int value, int base = DEC);
+    size_t println(long value, int base = DEC);
+    size_t println(unsigned long value, int base = DEC);
+
+    // test side: queue bytes for read, see what was written
+    void input(const char *text);
+    const char* output();
+    unsigned int outputLength();
+    void clearOutput();
+};
+
+extern ShimSerial Serial;
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef CHECK_INCLUDED
+#define CHECK_INCLUDED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Arduino.h>
+#include <TaskManager.h>
+
+// stops test at first failed condition
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      exit(1); \
+    } \
+  } while (0)
+
+// loop once per ms of shim clock
+inline void runMillis(unsigned long count) {
+  for(;count;count--) {
+    TM.loop();
+    shimAdvanceMillis(1);
+  }
+}
+
+inline void removeAll() {
+  Task *task;
+  while ((task = TM.nextTask(NULL))) TM.removeTask(task->id);
+}
+
+// task function that does nothing, for tasks only held in queue
+inline void idle(Task *task, byte trigger, TaskTime time) {
+}
+
+#endif
@@ -0,0 +1,68 @@
+// coroutine handlers, one handler object running several tasks
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <TaskCoroutine.h>
+#include <Triggers.h>
+#include <check.h>
+
+static ResourceTrigger resource;
+
+struct Step {
+  byte id;
+  byte step;
+  TaskTime time;
+};
+
+static Step steps[32];
+static byte stepCount;
+
+static void record(Task *task, byte step, TaskTime time) {
+  steps[stepCount].id = task->id;
+  steps[stepCount].step = step;
+  steps[stepCount].time = time;
+  stepCount++;
+}
+
+// resume point stays in task, handler keeps nothing per task
+class Blink : public StaticTaskHandler<Blink> {
+  public:
+    void start(byte id, TaskTime delay) {
+      Task *task = TM.addTask(id, TIME_TRIGGER, delay, dispatch, this);
+      if (task) TASK_RESUME(task) = 0;
+    }
+    void doTask(Task *task, byte trigger, TaskTime time) {
+      TASK_BEGIN();
+      record(task, 1, time);
+      TASK_SLEEP(TASK_MS(10));
+      record(task, 2, time);
+      TASK_AQUIRE(&resource);
+      record(task, 3, time);
+      TASK_SLEEP(TASK_MS(5));
+      resource.release();
+      record(task, 4, time);
+      TASK_END();
+    }
+};
+
+int main() {
+  Blink blink;
+  resource.init(0x02);
+  blink.start(1, 0);
+  blink.start(2, TASK_MS(3));
+  runMillis(30);
+  CHECK(stepCount==8);
+  // both tasks interleave on one handler object
+  CHECK(steps[0].id==1 && steps[0].step==1 && steps[0].time==0);
+  CHECK(steps[1].id==2 && steps[1].step==1 && steps[1].time==TASK_MS(3));
+  CHECK(steps[2].id==1 && steps[2].step==2 && steps[2].time==TASK_MS(10));
+  CHECK(steps[3].id==1 && steps[3].step==3 && steps[3].time==TASK_MS(11));
+  // sleep counts from dispatch time of task
+  CHECK(steps[4].id==2 && steps[4].step==2 && steps[4].time==TASK_MS(13));
+  CHECK(steps[5].id==1 && steps[5].step==4 && steps[5].time==TASK_MS(16));
+  // second task got resource once first released it
+  CHECK(steps[6].id==2 && steps[6].step==3 && steps[6].time==TASK_MS(16));
+  CHECK(steps[7].id==2 && steps[7].step==4 && steps[7].time==TASK_MS(21));
+  CHECK(!TM.nextTask(NULL));
+  puts("coroutine ok");
+  return 0;
+}
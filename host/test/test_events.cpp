@@ -0,0 +1,80 @@
+// event queue with a thread standing in for interrupt handler. posts are
+// only made for tasks that aren't pending already, so every post must run
+// its task exactly once, with ring full or not
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <check.h>
+#include <atomic>
+#include <thread>
+
+#define TASKS   (8)
+#define POSTS   (200000)
+// bit no trigger raises, tasks only run when posted
+#define POSTED_ONLY (0x80)
+#define EVENT       (0x40)
+
+static std::atomic<bool> pending[TASKS+1];
+static std::atomic<bool> eventPending;
+static unsigned long runs[TASKS+1];
+static unsigned long wrongRuns;
+static unsigned long eventRuns;
+
+static void onPost(Task *task, byte trigger, TaskTime time) {
+  if (!pending[task->id].exchange(false)) wrongRuns++;
+  runs[task->id]++;
+}
+
+static void onEvent(Task *task, byte trigger, TaskTime time) {
+  if (!eventPending.exchange(false)) wrongRuns++;
+  eventRuns++;
+}
+
+static std::atomic<unsigned long> posts;
+static std::atomic<unsigned long> events;
+static std::atomic<unsigned long> refused;
+
+static void interrupt() {
+  unsigned long i;
+  for(i=0;i<POSTS;i++) {
+    byte id = 1 + i%TASKS;
+    while (pending[id].load()) std::this_thread::yield();
+    pending[id].store(true);
+    // full ring refuses, handler would try on next interrupt
+    while (!TM.postTask(id)) {
+      refused++;
+      std::this_thread::yield();
+    }
+    posts++;
+    if (!eventPending.load()) {
+      eventPending.store(true);
+      while (!TM.postEvent(EVENT)) std::this_thread::yield();
+      events++;
+    }
+  }
+}
+
+int main() {
+  byte id;
+  for(id=1;id<=TASKS;id++) CHECK(TM.addTask(id, POSTED_ONLY, onPost, NULL));
+  CHECK(TM.addTask(TASKS+1, EVENT, onEvent, NULL));
+  std::thread producer(interrupt);
+  time_t start = time(NULL);
+  unsigned long total = 0;
+  while (total<POSTS || eventRuns<events.load()) {
+    TM.loop();
+    total = 0;
+    for(id=1;id<=TASKS;id++) total += runs[id];
+    CHECK(time(NULL)-start<60);
+    // give producer a turn on single core machines
+    std::this_thread::yield();
+  }
+  producer.join();
+  // last event could be posted after loop saw total reached
+  TM.loop();
+  CHECK(wrongRuns==0);
+  CHECK(total==POSTS && posts.load()==POSTS);
+  for(id=1;id<=TASKS;id++) CHECK(runs[id]==POSTS/TASKS);
+  CHECK(eventRuns==events.load() && eventRuns>0);
+  printf("events ok, %lu posts refused while ring was full\n", refused.load());
+  return 0;
+}
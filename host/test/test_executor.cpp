@@ -0,0 +1,91 @@
+// function tasks run on executor workers while loop goes on. jobs without
+// resource overlap, jobs sharing one never do
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <Triggers.h>
+#include <TaskExecutor.h>
+#include <check.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#define JOBS    (4)
+#define REPEATS (3)
+
+static TaskExecutor executor;
+static ResourceTrigger lock;
+static std::atomic<int> active;
+static std::atomic<int> maxActive;
+static std::atomic<int> runs;
+static std::atomic<bool> wrongHolder;
+
+static void work(Task *task, byte trigger, TaskTime time) {
+  int now = ++active;
+  int seen = maxActive;
+  while (now>seen && !maxActive.compare_exchange_weak(seen, now));
+  // resource is held by task for whole run
+  if (task->context && lock.holder()!=task->id) wrongHolder = true;
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  runs++;
+  active--;
+  // state of copy is kept between runs
+  byte *count = task->state<byte>();
+  if (++*count==REPEATS) task->clear();
+}
+
+// loop until jobs ran REPEATS times each, false on timeout
+static boolean runAll(int expected) {
+  int i;
+  for(i=0;i<5000;i++) {
+    TM.loop();
+    TaskTime wakeup;
+    if (runs==expected && !executor.running() && !TM.nextWakeup(&wakeup)) return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return false;
+}
+
+static void parallel() {
+  byte i;
+  active = 0;
+  maxActive = 0;
+  runs = 0;
+  for(i=0;i<JOBS;i++) CHECK(executor.start(1+i, TIME_TRIGGER, 0, work, NULL));
+  CHECK(runAll(JOBS*REPEATS));
+  CHECK(maxActive>1);
+}
+
+static void exclusive() {
+  byte i;
+  active = 0;
+  maxActive = 0;
+  runs = 0;
+  wrongHolder = false;
+  for(i=0;i<JOBS;i++) CHECK(executor.start(1+i, TIME_TRIGGER, 0, work, &lock, &lock));
+  CHECK(runAll(JOBS*REPEATS));
+  CHECK(maxActive==1);
+  CHECK(!wrongHolder);
+  CHECK(lock.isOn());
+}
+
+static void jobsLimit() {
+  byte i;
+  for(i=0;i<EXECUTOR_JOBS;i++) CHECK(executor.start(1+i, 0x80, 0, work, NULL));
+  CHECK(!executor.start(EXECUTOR_JOBS+1, 0x80, 0, work, NULL));
+  // jobs of removed tasks are taken back
+  for(i=0;i<EXECUTOR_JOBS;i++) TM.removeTask(1+i);
+  CHECK(executor.start(1, 0x80, 0, work, NULL));
+  TM.removeTask(1);
+}
+
+int main() {
+  TM.init();
+  lock.init(0x02);
+  executor.init(JOBS);
+  parallel();
+  exclusive();
+  jobsLimit();
+  executor.stop();
+  printf("executor ok\n");
+  return 0;
+}
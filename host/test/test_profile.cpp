@@ -0,0 +1,86 @@
+// TASK_PROFILING: run counts, run times, lateness buckets and ids that
+// don't fit in profiles, read back from binary report
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <check.h>
+
+static unsigned long runMicros;
+
+static void work(Task *task, byte trigger, TaskTime time) {
+  shimAdvanceMicros(runMicros);
+  task->time += TASK_MS(1000);
+}
+
+static const byte *report;
+
+static unsigned long readLong(unsigned int offset) {
+  return report[offset] | (unsigned long)report[offset+1]<<8
+      | (unsigned long)report[offset+2]<<16 | (unsigned long)report[offset+3]<<24;
+}
+
+// offset of report entry of id, 0 if it has none
+static unsigned int entryOf(byte id) {
+  unsigned int size = 13+2*PROFILE_LATE_BUCKETS;
+  unsigned int offset = 8;
+  byte i;
+  for(i=0;i<report[2];i++,offset+=size) {
+    if (report[offset]==id) return offset;
+  }
+  return 0;
+}
+
+// runs of late timer counted in bucket
+static unsigned short lateCount(unsigned int entry, byte bucket) {
+  unsigned int offset = entry+13+2*bucket;
+  return report[offset] | report[offset+1]<<8;
+}
+
+int main() {
+  TM.addTask(1, TIME_TRIGGER, 0, work, NULL);
+  // runs 0, 1, 3 and 5 ticks late land in buckets 0, 1, 2 and 3
+  static const byte lates[] = {0, 1, 3, 5};
+  byte i;
+  for(i=0;i<sizeof(lates);i++) {
+    Task *task = TM.findTask(1);
+    task->time = TM.now();
+    TM.updateTask(task);
+    shimAdvanceMillis(lates[i]);
+    runMicros = 100*(i+1);
+    TM.loop();
+  }
+  // event tasks are counted without lateness, third id has no room
+  TM.addTask(2, 0x02, work, NULL);
+  TM.addTask(3, 0x02, work, NULL);
+  runMicros = 50;
+  TM.postEvent(0x02);
+  TM.loop();
+
+  Serial.clearOutput();
+  TM.writeProfileReportSync();
+  report = (const byte*)Serial.output();
+  CHECK(Serial.outputLength()==8+2*(13+2*PROFILE_LATE_BUCKETS));
+  CHECK(report[0]==PROFILE_REPORT_TAG && report[1]==PROFILE_REPORT_VERSION);
+  CHECK(report[2]==2 && report[3]==PROFILE_LATE_BUCKETS);
+  CHECK(readLong(4)==1);
+
+  unsigned int entry = entryOf(1);
+  CHECK(entry);
+  CHECK(readLong(entry+1)==4);
+  CHECK(readLong(entry+5)==100+200+300+400);
+  CHECK(readLong(entry+9)==400);
+  for(i=0;i<4;i++) CHECK(lateCount(entry, i)==1);
+  for(;i<PROFILE_LATE_BUCKETS;i++) CHECK(lateCount(entry, i)==0);
+
+  entry = entryOf(2);
+  CHECK(entry);
+  CHECK(readLong(entry+1)==1 && readLong(entry+9)==50);
+  for(i=0;i<PROFILE_LATE_BUCKETS;i++) CHECK(lateCount(entry, i)==0);
+  CHECK(!entryOf(3));
+
+  TM.resetProfile();
+  Serial.clearOutput();
+  TM.writeProfileReportSync();
+  CHECK(Serial.outputLength()==8 && Serial.output()[2]==0);
+  puts("profile ok");
+  return 0;
+}
@@ -0,0 +1,507 @@
+// core TaskManager behaviour: deadline order, event buckets, priorities,
+// id index and slot reuse
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <TimerTasks.h>
+#include <Triggers.h>
+#include <string.h>
+#include <new>
+#include <check.h>
+
+static byte order[64];
+static byte orderCount;
+
+static void onTimer(Task *task, byte handle) {
+  order[orderCount++] = handle;
+}
+
+static void deadlineOrder() {
+  TimerTask timer;
+  timer.init(onTimer);
+  orderCount = 0;
+  timer.start(1, 1, 30);
+  timer.start(2, 2, 10);
+  timer.start(3, 3, 20);
+  timer.start(4, 4, 10);
+  runMillis(50);
+  CHECK(orderCount==4);
+  // equal deadlines keep no particular order, others are by time
+  CHECK(order[2]==3 && order[3]==1);
+  CHECK((order[0]==2 && order[1]==4) || (order[0]==4 && order[1]==2));
+}
+
+static void priorities() {
+  TimerTask timer;
+  timer.init(onTimer);
+  orderCount = 0;
+  timer.start(1, 1, 5);
+  timer.start(2, 2, 3);
+  timer.start(3, 3, 8);
+  TM.setPriority(TM.findTask(1), PRIORITY_HIGH);
+  // all due in same loop, high class first then deadline order
+  shimAdvanceMillis(10);
+  TM.loop();
+  CHECK(orderCount==3);
+  CHECK(order[0]==1 && order[1]==2 && order[2]==3);
+}
+
+static int captured;
+
+static void onCapture(Task *task, byte handle) {
+  captured++;
+}
+
+// registered with TM for good, so it outlives test
+static ResourceTrigger resource;
+
+static void eventTasks() {
+  resource.init(0x02);
+  CaptureResource capture;
+  capture.init(&resource, onCapture);
+  resource.aquire();
+  capture.start(10, 0);
+  captured = 0;
+  runMillis(5);
+  CHECK(captured==0);
+  resource.release();
+  runMillis(1);
+  CHECK(captured==1);
+  CHECK(!TM.findTask(10));
+}
+
+static int functionRuns;
+
+static void countRun(Task *task, byte trigger, TaskTime time) {
+  functionRuns++;
+  task->time += TASK_MS(1);
+}
+
+static void idIndex() {
+  functionRuns = 0;
+  CHECK(!TM.addTask(0, TIME_TRIGGER, countRun, NULL));
+  CHECK(TM.addTask(200, TIME_TRIGGER, countRun, NULL));
+  CHECK(!TM.addTask(200, TIME_TRIGGER, countRun, NULL));
+  CHECK(TM.findTask(200) && TM.findTask(200)->id==200);
+  CHECK(!TM.findTask(201));
+  runMillis(3);
+  CHECK(functionRuns==3);
+  TM.removeTask(200);
+  CHECK(!TM.findTask(200));
+  runMillis(3);
+  CHECK(functionRuns==3);
+}
+
+// index grows with slots, wide managers get one chain per id
+static void wideIndex() {
+  static_assert(TaskIdBuckets<10>::Value==16, "id buckets");
+  static_assert(TaskIdBuckets<40>::Value==64, "id buckets");
+  static_assert(TaskIdBuckets<300>::Value==256, "id buckets");
+  typedef BasicTaskManager<200, 2, byte> WideManager;
+  static WideManager manager;
+  manager.init();
+  unsigned int id;
+  for(id=1;id<=200;id++) CHECK(manager.addTask(id, TIME_TRIGGER, countRun, NULL));
+  for(id=1;id<=200;id++) CHECK(manager.findTask(id) && manager.findTask(id)->id==id);
+  CHECK(!manager.findTask(201));
+  for(id=1;id<=200;id+=2) manager.removeTask(id);
+  for(id=1;id<=200;id++) CHECK((manager.findTask(id)==NULL)==((id&1)==1));
+}
+
+static void fullQueue() {
+  byte id;
+  for(id=1;id<=TASK_QUEUE_SIZE;id++) CHECK(TM.addTask(id, TIME_TRIGGER, countRun, NULL));
+  CHECK(!TM.addTask(id, TIME_TRIGGER, countRun, NULL));
+  // freed slot is taken again
+  TM.removeTask(3);
+  CHECK(TM.addTask(id, TIME_TRIGGER, countRun, NULL));
+  for(id=1;id<=TASK_QUEUE_SIZE+1;id++) TM.removeTask(id);
+  CHECK(!TM.nextTask(NULL));
+}
+
+static unsigned short sweepValues[2][16];
+static byte sweepCount[2];
+static boolean sweepLast[2];
+
+static void onSweep(Task *task, byte handle, unsigned short value, boolean last) {
+  sweepValues[handle][sweepCount[handle]++] = value;
+  sweepLast[handle] = last;
+}
+
+// sweeps share one handler, each keeps its own pool entry
+static void statePools() {
+  PeriodicTask sweep;
+  sweep.init(onSweep);
+  memset(sweepCount, 0, sizeof(sweepCount));
+  sweep.start(1, 0, 10, 40, 10, TASK_MS(2));
+  sweep.start(2, 1, 100, 70, -10, TASK_MS(3));
+  runMillis(20);
+  CHECK(sweepCount[0]==4 && sweepCount[1]==4);
+  CHECK(sweepValues[0][3]==40 && sweepLast[0]);
+  CHECK(sweepValues[1][3]==70 && sweepLast[1]);
+  CHECK(!TM.nextTask(NULL));
+  CHECK(TaskStates.available()==TASK_POOL_SIZE);
+  // entries are shared by handlers, repeating timer takes one
+  TimerTask timer;
+  timer.init(onTimer);
+  CHECK(timer.start(1, 0, TASK_MS(1), TASK_MS(1), TIMER_FOREVER));
+  // all entries taken, next sweep is refused and its task removed
+  byte id;
+  for(id=2;id<=TASK_POOL_SIZE;id++) CHECK(sweep.start(id, 0, 0, 100, 1, TASK_MS(1)));
+  CHECK(!TaskStates.available());
+  CHECK(!sweep.start(id, 0, 0, 100, 1, TASK_MS(1)));
+  CHECK(!TM.findTask(id));
+  // one shot timers need no entry
+  CHECK(timer.start(id, 0, TASK_MS(1)));
+  TM.removeTask(id);
+  // entry of removed timer is free again
+  TM.removeTask(1);
+  CHECK(sweep.start(id, 0, 0, 100, 1, TASK_MS(1)));
+  CHECK(TM.findTask(id));
+  for(id=1;id<=TASK_POOL_SIZE+1;id++) TM.removeTask(id);
+  CHECK(TaskStates.available()==TASK_POOL_SIZE);
+  // handlers keep no state of their own tasks
+  CHECK(sizeof(TimerTask)<=2*sizeof(void*));
+}
+
+static void repeatingTimers() {
+  TimerTask timer;
+  timer.init(onTimer);
+  orderCount = 0;
+  timer.start(1, 7, TASK_MS(5), TASK_MS(5), 3);
+  timer.start(2, 8, TASK_MS(4));
+  Task *repeat = TM.findTask(1);
+  CHECK(timer.remaining(repeat)==3);
+  CHECK(!timer.stats(TM.findTask(2)));
+  runMillis(11);
+  CHECK(orderCount==3);
+  CHECK(order[0]==8 && order[1]==7 && order[2]==7);
+  CHECK(timer.remaining(repeat)==1);
+  CHECK(timer.stats(repeat)->runs==2);
+  runMillis(10);
+  CHECK(orderCount==4);
+  CHECK(!TM.nextTask(NULL));
+}
+
+// task moved by start from outside its doTask keeps heap in order
+static void restartOutside() {
+  TimerTask timer;
+  timer.init(onTimer);
+  orderCount = 0;
+  TaskTime begin = TM.now();
+  timer.start(1, 1, 10);
+  timer.start(2, 2, 20);
+  timer.start(3, 3, 30);
+  timer.start(4, 4, 40);
+  timer.start(TM.findTask(1), 1, 1000);
+  timer.start(TM.findTask(4), 4, 5);
+  TaskTime at[5];
+  while (orderCount<4) {
+    byte seen = orderCount;
+    TM.loop();
+    if (orderCount>seen) at[order[orderCount-1]] = TM.now()-begin;
+    shimAdvanceMillis(1);
+  }
+  CHECK(order[0]==4 && order[1]==2 && order[2]==3 && order[3]==1);
+  CHECK(at[4]==5 && at[2]==20 && at[3]==30 && at[1]==1000);
+}
+
+static byte busyRuns[8];
+
+// stays due and takes 400 us of the stepped clock
+static void busyRun(Task *task, byte trigger, TaskTime time) {
+  busyRuns[task->id]++;
+  shimAdvanceMicros(400);
+}
+
+static void addBusy(byte id, byte priority) {
+  TM.setPriority(TM.addTask(id, TIME_TRIGGER, busyRun, NULL), priority);
+}
+
+static void budget() {
+  byte id;
+  memset(busyRuns, 0, sizeof(busyRuns));
+  TM.setBudget(1000);
+  TM.resetLoadStats();
+  for(id=1;id<=4;id++) addBusy(id, PRIORITY_HIGH);
+  addBusy(5, PRIORITY_LOW);
+  // three high runs spend budget, fourth and low one wait
+  TM.loop();
+  TaskLoadStats load = TM.loadStats();
+  CHECK(load.overloads==1 && load.deferred==2 && load.shed==0);
+  CHECK(busyRuns[1]+busyRuns[2]+busyRuns[3]+busyRuns[4]==3 && !busyRuns[5]);
+  // next loop starts behind high class, low isn't starved by it
+  TM.loop();
+  CHECK(busyRuns[5]==1);
+  CHECK(TM.loadStats().overloads==2);
+
+  // low class is shed: counted when budget runs out before it and skipped
+  // in loop after an overload
+  TM.removeTask(5);
+  TM.loop();
+  TM.setShedPriority(PRIORITY_LOW);
+  addBusy(5, PRIORITY_LOW);
+  TM.resetLoadStats();
+  TM.loop();
+  TM.loop();
+  load = TM.loadStats();
+  CHECK(load.overloads==2 && load.deferred==2 && load.shed==2);
+  CHECK(busyRuns[5]==1);
+  // load drops, low class runs again once a loop stays in budget
+  for(id=2;id<=4;id++) TM.removeTask(id);
+  TM.loop();
+  CHECK(busyRuns[5]==1 && TM.loadStats().shed==3);
+  TM.loop();
+  CHECK(busyRuns[5]==2);
+  TM.removeTask(1);
+  TM.removeTask(5);
+  TM.setBudget(0);
+  TM.setShedPriority(TASK_PRIORITIES);
+}
+
+static PeriodicTask lateSweep;
+static unsigned short lateValue;
+static unsigned short lateMissed;
+static boolean lateLast;
+
+static void onLateSweep(Task *task, byte handle, unsigned short value, boolean last) {
+  lateValue = value;
+  lateLast = last;
+  lateMissed = lateSweep.missedSteps();
+}
+
+// first step runs at once, second one 25 ms after its time
+static void stallSweep(byte overrun) {
+  lateSweep.start(1, 0, 0, 100, 10, TASK_MS(10));
+  TM.findTask(1)->overrun = overrun;
+  TM.loop();
+  shimAdvanceMillis(35);
+  TM.loop();
+}
+
+static byte failedId;
+static TaskTime failedLate;
+
+static void onFail(Task *task, TaskTime late) {
+  failedId = task->id;
+  failedLate = late;
+}
+
+static void overrunPolicies() {
+  lateSweep.init(onLateSweep);
+  // one late step is sent, the one after it is still due
+  stallSweep(OVERRUN_CATCH_UP);
+  CHECK(lateValue==10 && lateMissed==0);
+  Task *task = TM.findTask(1);
+  CHECK((TaskSpan)(TM.now()-task->time)>=0);
+  TM.removeTask(1);
+  // two periods are dropped, values go on from where they were
+  stallSweep(OVERRUN_SKIP);
+  CHECK(lateValue==10 && lateMissed==2);
+  task = TM.findTask(1);
+  CHECK(task->time-TM.now()==TASK_MS(5));
+  TM.removeTask(1);
+  // missed steps are merged into value sent
+  stallSweep(OVERRUN_COALESCE);
+  CHECK(lateValue==30 && lateMissed==2);
+  TM.removeTask(1);
+  // coalescing stops at last value, increments times missed steps need long
+  lateSweep.start(1, 0, 0, 60000, 20000, TASK_MS(1));
+  TM.findTask(1)->overrun = OVERRUN_COALESCE;
+  TM.loop();
+  shimAdvanceMillis(50);
+  TM.loop();
+  // step after it would pass 0xFFFF, so it is last instead of wrapping
+  CHECK(lateValue==60000 && lateMissed==2 && lateLast);
+  CHECK(!TM.findTask(1));
+
+  // failing task is removed instead of run, callback gets how late it is
+  TimerTask timer;
+  timer.init(onTimer);
+  orderCount = 0;
+  failedId = 0;
+  TM.onOverrun(onFail);
+  unsigned long overruns = TM.overrunCount();
+  timer.start(1, 1, TASK_MS(5));
+  timer.start(2, 2, TASK_MS(5));
+  TM.findTask(1)->overrun = OVERRUN_FAIL;
+  shimAdvanceMillis(5);
+  shimAdvanceMicros(LATE_TIME_THRESHOLD*(1000/TASK_TICKS_PER_MS));
+  TM.loop();
+  CHECK(failedId==1 && failedLate==(TaskTime)LATE_TIME_THRESHOLD);
+  CHECK(!TM.findTask(1));
+  // late task of other policy still runs
+  CHECK(orderCount==1 && order[0]==2);
+  CHECK(TM.overrunCount()-overruns==2);
+  TM.onOverrun(NULL);
+}
+
+static SweepChannel channels[2];
+static unsigned short groupValues[8][2];
+static byte groupCount;
+static boolean groupLast;
+
+static void onGroup(Task *task, byte handle, SweepChannel *channels, byte count, boolean last) {
+  groupValues[groupCount][0] = channels[0].value;
+  groupValues[groupCount][1] = channels[1].value;
+  groupCount++;
+  groupLast = last;
+}
+
+static void sweepGroups() {
+  SweepTask group;
+  group.init(onGroup);
+  groupCount = 0;
+  // second channel reaches its end first and stays there
+  channels[0].set(0, 30, 10);
+  channels[1].set(100, 60, -20);
+  CHECK(group.start(1, 0, channels, 2, TASK_MS(2)));
+  runMillis(20);
+  CHECK(groupCount==4 && groupLast);
+  static const unsigned short expected[4][2] = {{0, 100}, {10, 80}, {20, 60}, {30, 60}};
+  byte i;
+  for(i=0;i<4;i++) {
+    CHECK(groupValues[i][0]==expected[i][0] && groupValues[i][1]==expected[i][1]);
+  }
+  CHECK(!TM.findTask(1));
+}
+
+static void curveSweeps() {
+  PeriodicTask sweep;
+  sweep.init(onSweep);
+  memset(sweepCount, 0, sizeof(sweepCount));
+  // points of curve at quarters, straight line between them elsewhere
+  CHECK(sweep.start(1, 0, 0, 1000, 4, TASK_MS(1), CurveEaseIn));
+  CHECK(sweep.start(2, 1, 1000, 0, 8, TASK_MS(1), CurveSCurve));
+  runMillis(12);
+  CHECK(sweepCount[0]==5 && sweepLast[0]);
+  static const unsigned short easeIn[5] = {0, 62, 250, 562, 1000};
+  byte i;
+  for(i=0;i<5;i++) CHECK(sweepValues[0][i]==easeIn[i]);
+  // falling sweep, s curve is symmetric around its middle. shifts round
+  // down, so mirrored values could miss by one
+  CHECK(sweepCount[1]==9 && sweepLast[1]);
+  CHECK(sweepValues[1][0]==1000 && sweepValues[1][4]==500 && sweepValues[1][8]==0);
+  CHECK(sweepValues[1][2]+sweepValues[1][6]>=999 && sweepValues[1][2]+sweepValues[1][6]<=1000);
+  CHECK(!TM.nextTask(NULL));
+}
+
+// loops of a sketch that sleeps until next wakeup
+static unsigned int wakeups() {
+  unsigned int count = 0;
+  TaskTime wakeup;
+  while (TM.nextWakeup(&wakeup)) {
+    TaskSpan wait = wakeup - TM.now();
+    if (wait>0) shimAdvanceMillis(wait);
+    TM.loop();
+    count++;
+  }
+  return count;
+}
+
+static void slackWindows() {
+  TimerTask timer;
+  timer.init(onTimer);
+  // window 90..120 is open when timer due at 100 wakes loop
+  orderCount = 0;
+  TaskTime start = TM.now();
+  timer.start(1, 1, 90, 30);
+  timer.start(2, 2, 100);
+  CHECK(wakeups()==1);
+  CHECK(orderCount==2 && TM.now()==start+100);
+  // windows 7..8 and 8..9 share 8
+  orderCount = 0;
+  start = TM.now();
+  timer.start(1, 1, 7, 1);
+  timer.start(2, 2, 8, 1);
+  CHECK(wakeups()==1);
+  CHECK(orderCount==2 && TM.now()==start+8);
+  // 5..6 is over before 8..9 opens
+  start = TM.now();
+  timer.start(1, 1, 5, 1);
+  timer.start(2, 2, 8, 1);
+  CHECK(wakeups()==2);
+  CHECK(TM.now()==start+9);
+  // open window alone doesn't wake loop
+  orderCount = 0;
+  timer.start(1, 1, 2, 10);
+  runMillis(5);
+  CHECK(orderCount==0);
+  runMillis(10);
+  CHECK(orderCount==1);
+}
+
+// on while flag is set, registered with a manager other than TM
+class FlagTrigger : public Trigger {
+  public:
+    boolean on;
+
+    boolean isOn() { return on; }
+    byte trigger() { return 0x10; }
+    byte setTrigger(byte event) { return on ? event|0x10 : event; }
+    byte updateTrigger(byte event) { return on ? event|0x10 : event&~0x10; }
+};
+
+// idleLoop sleeps until next timer is due and moves shim clock with it
+static void idleSleep() {
+  functionRuns = 0;
+  TaskTime start = TM.now();
+  CHECK(TM.addTask(1, TIME_TRIGGER, TASK_MS(20), countRun, NULL));
+  TM.idleLoop();
+  CHECK(TM.now()-start==TASK_MS(20));
+  CHECK(functionRuns==0);
+  // runs task, then sleeps until its next run a ms later
+  TM.idleLoop();
+  CHECK(functionRuns==1);
+  CHECK(TM.now()-start==TASK_MS(21));
+  TM.removeTask(1);
+  // nothing queued, returns at once
+  TM.idleLoop();
+  CHECK(TM.now()-start==TASK_MS(21));
+}
+
+static void ownManager() {
+  typedef BasicTaskManager<4, 2, byte> SmallManager;
+  // memory of a member or local manager isn't zeroed
+  static union {
+    unsigned char raw[sizeof(SmallManager)];
+    void *align;
+  } memory;
+  // volatile, so filling isn't dropped as dead store before construction
+  volatile unsigned char *fill = memory.raw;
+  unsigned int i;
+  for(i=0;i<sizeof(memory.raw);i++) fill[i] = 0xA5;
+  SmallManager *manager = new(memory.raw) SmallManager();
+  FlagTrigger flag;
+  flag.on = true;
+  // registered before init and kept by it
+  manager->registerTrigger(&flag);
+  manager->init();
+  functionRuns = 0;
+  CHECK(manager->addTask(1, 0x10, countRun, NULL));
+  manager->loop();
+  CHECK(functionRuns==1);
+  flag.on = false;
+  manager->loop();
+  CHECK(functionRuns==1);
+}
+
+int main() {
+  deadlineOrder();
+  priorities();
+  eventTasks();
+  idIndex();
+  wideIndex();
+  fullQueue();
+  statePools();
+  repeatingTimers();
+  restartOutside();
+  overrunPolicies();
+  sweepGroups();
+  curveSweeps();
+  slackWindows();
+  budget();
+  idleSleep();
+  ownManager();
+  puts("scheduler ok");
+  return 0;
+}
@@ -0,0 +1,148 @@
+// semaphore line: fairness under contention, reused ids and restore
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <Triggers.h>
+#include <TaskSnapshot.h>
+#include <check.h>
+
+#define COMPETITORS (20)
+
+static SemaphoreTrigger semaphore;
+static CaptureSemaphore capture;
+static unsigned long served[COMPETITORS+1];
+static byte lastHandle;
+static boolean hold;
+
+// take turn, give permit back and line up again. on hold permit is kept
+// and task ends
+static void onPermit(Task *task, byte handle) {
+  served[handle]++;
+  lastHandle = handle;
+  if (hold) return;
+  semaphore.release();
+  capture.start(task, handle);
+}
+
+// high class tasks compete with low ones, each still gets same share
+static void noStarvation() {
+  byte i;
+  memset(served, 0, sizeof(served));
+  for(i=1;i<=COMPETITORS;i++) {
+    CHECK(capture.start(i, i));
+    TM.setPriority(TM.findTask(i), i<=COMPETITORS/2 ? PRIORITY_HIGH : PRIORITY_LOW);
+  }
+  unsigned long loop;
+  for(loop=0;loop<1000;loop++) TM.loop();
+  unsigned long least = served[1];
+  unsigned long most = served[1];
+  for(i=2;i<=COMPETITORS;i++) {
+    if (served[i]<least) least = served[i];
+    if (served[i]>most) most = served[i];
+  }
+  CHECK(least>0 && most-least<=1);
+  removeAll();
+}
+
+// waiter whose id was taken by other task must not block line
+static void reusedId() {
+  hold = true;
+  CHECK(semaphore.tryAquire());
+  CHECK(capture.start(5, 5));
+  CHECK(capture.start(6, 6));
+  TM.removeTask(5);
+  CHECK(TM.addTask(5, semaphore.trigger(), idle, NULL));
+  semaphore.release();
+  lastHandle = 0;
+  TM.loop();
+  CHECK(lastHandle==6);
+  // same when id is reused by another waiter, it lines up behind
+  CHECK(capture.start(7, 7));
+  TM.removeTask(7);
+  CHECK(capture.start(8, 8));
+  CHECK(capture.start(7, 7));
+  semaphore.release();
+  TM.loop();
+  CHECK(lastHandle==8);
+  semaphore.release();
+  TM.loop();
+  CHECK(lastHandle==7);
+  hold = false;
+  semaphore.release();
+  removeAll();
+}
+
+// restored waiters line up again and get permits
+static void restoredWaiters() {
+  Snapshot.init();
+  CHECK(Snapshot.registerStaticHandler(0, &capture));
+  hold = true;
+  CHECK(semaphore.tryAquire());
+  CHECK(capture.start(1, 1));
+  CHECK(capture.start(2, 2));
+  CHECK(Snapshot.save()==2);
+  // reset frees permit, held ones are not saved
+  removeAll();
+  semaphore.release();
+  CHECK(Snapshot.restore());
+  lastHandle = 0;
+  TM.loop();
+  CHECK(lastHandle==1 || lastHandle==2);
+  byte firstHandle = lastHandle;
+  semaphore.release();
+  TM.loop();
+  CHECK(lastHandle==3-firstHandle);
+  hold = false;
+  semaphore.release();
+  removeAll();
+  remove(TASK_SNAPSHOT_FILE);
+}
+
+// only first waiter waits for permit, others stay parked until they are
+// first, or until recheck finds first one gone
+static void parkedWaiters() {
+  hold = true;
+  CHECK(semaphore.tryAquire());
+  CHECK(capture.start(1, 1));
+  CHECK(capture.start(2, 2));
+  CHECK(capture.start(3, 3));
+  CHECK(TM.findTask(1)->trigger==semaphore.trigger());
+  CHECK(TM.findTask(2)->trigger & TIME_TRIGGER);
+  CHECK(TM.findTask(3)->trigger & TIME_TRIGGER);
+  semaphore.release();
+  lastHandle = 0;
+  TM.loop();
+  CHECK(lastHandle==1);
+  CHECK(TM.findTask(2)->trigger==semaphore.trigger());
+  CHECK(TM.findTask(3)->trigger & TIME_TRIGGER);
+  // removed first waiter is dropped on release
+  TM.removeTask(2);
+  semaphore.release();
+  TM.loop();
+  CHECK(lastHandle==3);
+  semaphore.release();
+  // removed while permit is free, waiter behind finds out on recheck
+  CHECK(semaphore.tryAquire());
+  CHECK(capture.start(4, 4));
+  CHECK(capture.start(5, 5));
+  semaphore.release();
+  TM.removeTask(4);
+  lastHandle = 0;
+  runMillis(SEMAPHORE_RECHECK/TASK_MS(1)-1);
+  CHECK(lastHandle==0);
+  runMillis(2);
+  CHECK(lastHandle==5);
+  hold = false;
+  semaphore.release();
+  removeAll();
+}
+
+int main() {
+  semaphore.init(0x02, 1);
+  capture.init(&semaphore, onPermit);
+  noStarvation();
+  reusedId();
+  restoredWaiters();
+  parkedWaiters();
+  puts("semaphore ok");
+  return 0;
+}
@@ -0,0 +1,136 @@
+// snapshot save and restore of task state, pool entries, resources and checksum
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <TimerTasks.h>
+#include <SerialTasks.h>
+#include <TaskSnapshot.h>
+#include <string.h>
+#include <check.h>
+
+static byte fired[8];
+
+static void onTimer(Task *task, byte handle) {
+  fired[handle]++;
+}
+
+static unsigned short sweepValue;
+static byte sweepRuns;
+
+static void onSweep(Task *task, byte handle, unsigned short value, boolean last) {
+  sweepValue = value;
+  sweepRuns++;
+}
+
+static void count(Task *task, byte trigger, TaskTime time) {
+  (*task->state<unsigned short>())++;
+  task->time += TASK_MS(10);
+}
+
+static long fileSize() {
+  FILE *file = fopen(TASK_SNAPSHOT_FILE, "rb");
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+static void corrupt(long offset) {
+  FILE *file = fopen(TASK_SNAPSHOT_FILE, "r+b");
+  fseek(file, offset, SEEK_SET);
+  int value = fgetc(file);
+  fseek(file, offset, SEEK_SET);
+  fputc(value^0x10, file);
+  fclose(file);
+}
+
+int main() {
+  TimerTask timer;
+  PeriodicTask sweep;
+  ResourceTrigger lock;
+  byte buffer[40];
+  byte i;
+  for(i=0;i<sizeof(buffer);i++) buffer[i] = i;
+  timer.init(onTimer);
+  sweep.init(onSweep);
+  SerialOutSemaphore.init(0x02);
+  lock.init(0x04);
+  Snapshot.init();
+  CHECK(Snapshot.registerStaticHandler(0, &timer));
+  CHECK(Snapshot.registerStaticHandler(1, &sweep));
+  CHECK(Snapshot.registerHandler(2, count, NULL));
+  CHECK(Snapshot.registerStaticHandler(3, &PacketTask));
+  CHECK(Snapshot.registerStaticHandler(4, &ReleaseTask));
+  CHECK(Snapshot.registerResource(&SerialOutSemaphore));
+  CHECK(Snapshot.registerResource(&lock));
+
+  timer.start(1, 1, TASK_MS(50));
+  timer.start(2, 2, TASK_MS(5), TASK_MS(5), TIMER_FOREVER);
+  sweep.start(3, 0, 0, 100, 1, TASK_MS(1));
+  Task *counter = TM.addTask(4, TIME_TRIGGER, TASK_MS(10), count, NULL);
+  *counter->state<unsigned short>() = 1000;
+  // two bytes a ms, send is half done at snapshot
+  CHECK(PacketTask.start(5, buffer, 2, sizeof(buffer), TASK_MS(1)));
+  // held outside of tasks, nothing would release it after reset
+  lock.aquire();
+  runMillis(10);
+  TM.loop();
+  CHECK(fired[2]==2);
+  CHECK(SerialOutSemaphore.holder()==5 && !lock.holder());
+  unsigned short lastSweep = sweepValue;
+  CHECK(Snapshot.save()==5);
+
+  // reset: clock starts over, nothing is queued and resources are free
+  removeAll();
+  SerialOutSemaphore.release();
+  lock.release();
+  CHECK(TaskStates.available()==TASK_POOL_SIZE);
+  shimSetMicros(0);
+  shimAdvanceMillis(3);
+  Serial.clearOutput();
+  CHECK(Snapshot.restore());
+  for(i=1;i<=5;i++) CHECK(TM.findTask(i));
+  // times are moved to new clock
+  CHECK(TM.findTask(1)->time==TASK_MS(3+40));
+  CHECK(TM.findTask(4)->time==TASK_MS(3+10));
+  CHECK(*TM.findTask(4)->state<unsigned short>()==1001);
+  // pooled state took new entries
+  CHECK(TaskStates.available()==TASK_POOL_SIZE-3);
+  CHECK(timer.remaining(TM.findTask(2))==TIMER_FOREVER);
+  CHECK(timer.stats(TM.findTask(2))->runs==2);
+  // resource comes back with its holder only
+  CHECK(!SerialOutSemaphore.isOn() && SerialOutSemaphore.holder()==5);
+  CHECK(lock.isOn());
+
+  // sweep goes on from its last value, send from its last byte. loops at
+  // restore time and a ms later, when sweep is due
+  runMillis(2);
+  CHECK(sweepValue==lastSweep+1);
+  runMillis(9);
+  CHECK(fired[2]==4);
+  CHECK(Serial.outputLength() && !strstr(Serial.output(), "t 5"));
+  CHECK(strstr(Serial.output(), " 38 39"));
+  // release task frees serial once send is done
+  runMillis(TASK_MS(100)/TASK_MS(1));
+  CHECK(SerialOutSemaphore.isOn());
+  runMillis(30);
+  CHECK(fired[1]==1);
+  CHECK(sweepValue==100);
+  removeAll();
+
+  // any changed byte fails fletcher-16 and nothing is added
+  long size = fileSize();
+  long offset;
+  for(offset=0;offset<size;offset++) {
+    corrupt(offset);
+    CHECK(!Snapshot.restore());
+    CHECK(!TM.nextTask(NULL));
+    corrupt(offset);
+  }
+  CHECK(Snapshot.restore());
+  removeAll();
+  Snapshot.erase();
+  CHECK(!Snapshot.restore());
+  remove(TASK_SNAPSHOT_FILE);
+  puts("snapshot ok");
+  return 0;
+}
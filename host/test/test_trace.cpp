@@ -0,0 +1,48 @@
+// trace ring drained by TraceSendTask, whose own runs stay out of trace
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <SerialTasks.h>
+#include <check.h>
+
+static TraceSendTask Tracer;
+static unsigned long held;
+
+static void worker(Task *task, byte trigger, TaskTime time) {
+  task->time += TASK_MS(50);
+}
+
+static void run(unsigned long ms) {
+  for(;ms;ms--) {
+    TM.loop();
+    if (!SerialOutSemaphore.isOn()) held++;
+    shimAdvanceMillis(1);
+  }
+}
+
+int main() {
+  SerialOutSemaphore.init(0x02);
+  Tracer.start(1, TASK_MS(10));
+  // settle trigger record of first loops
+  run(100);
+  Serial.clearOutput();
+  held = 0;
+  // sender alone records nothing, so it never writes or takes serial
+  run(10000);
+  CHECK(Serial.outputLength()==0);
+  CHECK(held==0);
+  CHECK(taskTracePending()==0);
+
+  // records of other task are written, then sender goes quiet again
+  TM.addTask(2, TIME_TRIGGER, worker, NULL);
+  run(1000);
+  CHECK(Serial.outputLength()>0);
+  TM.removeTask(2);
+  run(1000);
+  unsigned int length = Serial.outputLength();
+  held = 0;
+  run(10000);
+  CHECK(Serial.outputLength()==length);
+  CHECK(held==0);
+  puts("trace ok");
+  return 0;
+}
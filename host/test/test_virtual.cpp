@@ -0,0 +1,104 @@
+// TASK_VIRTUAL_TIME: runUntil jumps idle time and runs same tasks at same
+// times in same order as a clock stepped one tick per loop
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <TimerTasks.h>
+#include <Triggers.h>
+#include <string.h>
+#include <check.h>
+
+struct Run {
+  byte handle;
+  TaskTime time;
+};
+
+static Run runs[64];
+static byte runCount;
+
+static ResourceTrigger resource;
+static TimerTask timer;
+static PeriodicTask sweep;
+static CaptureResource capture;
+
+static void record(byte handle) {
+  if (runCount<64) {
+    runs[runCount].handle = handle;
+    runs[runCount].time = TM.now();
+  }
+  runCount++;
+}
+
+static void onTimer(Task *task, byte handle) {
+  record(handle);
+  if (handle==9) {
+    // held by task, capture waits for timer 10 to release it
+    resource.aquire();
+    capture.start(20, 20);
+    timer.start(10, 10, 6);
+  } else if (handle==10) {
+    resource.release();
+  }
+}
+
+static void onSweep(Task *task, byte handle, unsigned short value, boolean last) {
+  record(100+value/10);
+}
+
+static void onCapture(Task *task, byte handle) {
+  record(handle);
+}
+
+static void schedule() {
+  runCount = 0;
+  timer.start(1, 1, 30);
+  timer.start(2, 2, 10);
+  timer.start(3, 3, 20);
+  timer.start(4, 4, 11);
+  timer.start(5, 5, 12, 5);
+  timer.start(6, 6, 3, 7, 5);
+  timer.start(9, 9, 15);
+  sweep.start(7, 0, 0, 50, 10, 4);
+}
+
+int main() {
+  timer.init(onTimer);
+  sweep.init(onSweep);
+  resource.init(0x02);
+  capture.init(&resource, onCapture);
+
+  TaskTime t;
+  TM.setTime(1000);
+  schedule();
+  for(t=1000;t<=1100;t++) {
+    TM.setTime(t);
+    TM.loop();
+  }
+  CHECK(!TM.nextTask(NULL));
+  Run stepped[64];
+  byte steppedCount = runCount;
+  CHECK(steppedCount==19);
+  memcpy(stepped, runs, sizeof(runs));
+
+  TM.setTime(1000);
+  schedule();
+  TM.runUntil(1100);
+  CHECK(TM.now()==1100);
+  CHECK(runCount==steppedCount);
+  byte i;
+  for(i=0;i<runCount;i++) {
+    CHECK(runs[i].handle==stepped[i].handle);
+    CHECK(runs[i].time==stepped[i].time);
+  }
+
+  // idleLoop jumps to next due task instead of sleeping
+  TM.setTime(0);
+  runCount = 0;
+  timer.start(1, 1, 500);
+  TM.idleLoop();
+  CHECK(TM.now()==500 && runCount==0);
+  TM.idleLoop();
+  CHECK(runCount==1 && runs[0].time==500);
+  removeAll();
+  puts("virtual ok");
+  return 0;
+}
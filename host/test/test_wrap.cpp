@@ -0,0 +1,126 @@
+// scheduling across wrap of 32 bit TaskTime, for millis and
+// TASK_MICROS clocks
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <TimerTasks.h>
+#include <check.h>
+
+static_assert(sizeof(TaskTime)==4, "wrap test needs 32 bit clock");
+
+// clock ticks before wrap
+#define WRAP(ticks) ((TaskTime)0-(ticks))
+
+static void setClock(TaskTime ticks) {
+#ifdef TASK_MICROS
+  shimSetMicros(ticks);
+#else
+  shimSetMillis(ticks);
+#endif
+}
+
+struct Run {
+  byte handle;
+  TaskTime time;
+};
+
+static Run runs[32];
+static byte runCount;
+
+static void onTimer(Task *task, byte handle) {
+  runs[runCount].handle = handle;
+  runs[runCount].time = TM.now();
+  runCount++;
+}
+
+static void onSweep(Task *task, byte handle, unsigned short value, boolean last) {
+  runs[runCount].handle = value;
+  runs[runCount].time = TM.now();
+  runCount++;
+}
+
+// loop every ms or every 100 us, fine enough to see early or late runs
+static void run(TaskTime ticks) {
+  TaskTime step = TASK_MS(1)/10 ? TASK_MS(1)/10 : 1;
+  for(;ticks>=step;ticks-=step) {
+    TM.loop();
+#ifdef TASK_MICROS
+    shimAdvanceMicros(step);
+#else
+    shimAdvanceMillis(step);
+#endif
+  }
+}
+
+static void reset() {
+  removeAll();
+  runCount = 0;
+}
+
+// timers due before and after wrap run in deadline order and on time
+static void deadlines() {
+  TimerTask timer;
+  timer.init(onTimer);
+  setClock(WRAP(TASK_MS(5)));
+  timer.start(1, 1, TASK_MS(10));
+  timer.start(2, 2, TASK_MS(3));
+  timer.start(3, 3, TASK_MS(7));
+  TaskTime wake;
+  CHECK(TM.nextWakeup(&wake) && wake==WRAP(TASK_MS(2)));
+  run(TASK_MS(20));
+  CHECK(runCount==3);
+  CHECK(runs[0].handle==2 && runs[0].time==WRAP(TASK_MS(2)));
+  CHECK(runs[1].handle==3 && runs[1].time==TASK_MS(2));
+  CHECK(runs[2].handle==1 && runs[2].time==TASK_MS(5));
+  reset();
+}
+
+// repeating timer keeps its period across wrap
+static void repeats() {
+  TimerTask timer;
+  timer.init(onTimer);
+  setClock(WRAP(TASK_MS(7)));
+  timer.start(1, 1, TASK_MS(3), TASK_MS(3), 5);
+  run(TASK_MS(30));
+  CHECK(runCount==5);
+  byte i;
+  for(i=0;i<5;i++) CHECK(runs[i].time==WRAP(TASK_MS(4))+i*TASK_MS(3));
+  reset();
+}
+
+// sweep steps stay a period apart across wrap
+static void sweeps() {
+  PeriodicTask sweep;
+  sweep.init(onSweep);
+  setClock(WRAP(TASK_MS(3)));
+  sweep.start(1, 0, 0, 4, 1, TASK_MS(2));
+  run(TASK_MS(20));
+  CHECK(runCount==5);
+  byte i;
+  for(i=0;i<5;i++) {
+    CHECK(runs[i].handle==i);
+    CHECK(runs[i].time==WRAP(TASK_MS(3))+i*TASK_MS(2));
+  }
+  reset();
+}
+
+// slack window across wrap is kept, timer is neither early nor too late
+static void slack() {
+  TimerTask timer;
+  timer.init(onTimer);
+  setClock(WRAP(TASK_MS(4)));
+  timer.start(1, 1, TASK_MS(3), TASK_MS(4));
+  run(TASK_MS(20));
+  CHECK(runCount==1);
+  CHECK((TaskSpan)(runs[0].time-WRAP(TASK_MS(1)))>=0);
+  CHECK((TaskSpan)(runs[0].time-WRAP(TASK_MS(1)))<=(TaskSpan)TASK_MS(4));
+  reset();
+}
+
+int main() {
+  deadlines();
+  repeats();
+  sweeps();
+  slack();
+  puts("wrap ok");
+  return 0;
+}
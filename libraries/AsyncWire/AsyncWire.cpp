@@ -4,8 +4,22 @@ extern "C" {
   #include <twi.h>
 }
 
+// trace hook of TaskManager, defined only when it is built with TASK_TRACE.
+// declared weak here instead of including TaskManager.h, so sketches using
+// AsyncWire alone don't get TaskManager and its TM. types match TRACE_TWI_*
+extern void taskTrace(byte type, byte data) __attribute__((weak));
+#define TWI_TRACE_START (6)
+#define TWI_TRACE_DONE  (7)
+
 uint8_t AsyncWire::sendBuf[BUF_SIZE];
 uint8_t AsyncWire::recvBuf[BUF_SIZE];
+void (*AsyncWire::completeCallback)(void);
+
+// pass scheduling result through, record op if it was started
+static inline uint8_t traceStart(uint8_t address, uint8_t result) {
+  if (taskTrace && result==TWI_ASYNC_SCHEDULED) taskTrace(TWI_TRACE_START, address);
+  return result;
+}
 
 // init wire (in master mode)
 void AsyncWire::init() {
@@ -16,6 +30,7 @@ void AsyncWire::init() {
   txBufferLength = 0;
   // init library
   twi_init();
+  if (taskTrace) twi_attachCompleteHandler(twiComplete);
 }
 
 // start exchange with address and initialise pointers to internal buffers 
@@ -81,13 +96,13 @@ int8_t AsyncWire::doAsync() {
   }
   if (rxRequested==0) {
     // send only
-    return twi_asyncWriteTo(address, txBuffer, txBufferIndex, 1);
+    return traceStart(address, twi_asyncWriteTo(address, txBuffer, txBufferIndex, 1));
   } else if (txBufferIndex==0) {
     // receive only
-    return twi_asyncReadFrom(address, rxBuffer, rxRequested, 1);
+    return traceStart(address, twi_asyncReadFrom(address, rxBuffer, rxRequested, 1));
   } else {
     // send then receive
-    return twi_asyncWriteRead(address, txBuffer, txBufferIndex, rxBuffer, rxRequested, 1);
+    return traceStart(address, twi_asyncWriteRead(address, txBuffer, txBufferIndex, rxBuffer, rxRequested, 1));
   }
 }
 
@@ -121,17 +136,17 @@ int8_t AsyncWire::send(uint8_t address, uint8_t data1, uint8_t data2) {
 
 // send array and terminate communication
 int8_t AsyncWire::send(uint8_t address, uint8_t *data, size_t length) {
-  return twi_asyncWriteTo(address, data, length, 1);
+  return traceStart(address, twi_asyncWriteTo(address, data, length, 1));
 }
 
 // request size bytes from address
 int8_t AsyncWire::read(uint8_t address, uint8_t size, uint8_t *buffer) {
-  return twi_asyncReadFrom(address, buffer, size, 1);
+  return traceStart(address, twi_asyncReadFrom(address, buffer, size, 1));
 }
 
 // read a single byte
 int8_t AsyncWire::read(uint8_t address) {
-  return twi_asyncReadFrom(address, recvBuf, 1, 1);
+  return traceStart(address, twi_asyncReadFrom(address, recvBuf, 1, 1));
 }
 
 // status check. if true last operation is finished
@@ -145,6 +160,18 @@ uint8_t AsyncWire::getStatus() {
   return twi_lastAsyncOpStatus();
 }
 
+// callback run from twi interrupt when async op ends
+void AsyncWire::onComplete(void (*callback)(void)) {
+  completeCallback = callback;
+  twi_attachCompleteHandler(twiComplete);
+}
+
+// twi interrupt context
+void AsyncWire::twiComplete() {
+  if (taskTrace) taskTrace(TWI_TRACE_DONE, twi_lastAddr()>>1);
+  if (completeCallback) completeCallback();
+}
+
 #ifdef ASYNC_DEBUG_METHODS
 
 uint8_t AsyncWire::twiStatus() {
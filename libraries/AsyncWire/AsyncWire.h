@@ -36,6 +36,10 @@ class AsyncWire {
     // async op address
     uint8_t address;
 
+    // user function for twi completion
+    static void (*completeCallback)(void);
+    static void twiComplete();
+
   public:
     // init wire (in master mode)
     void init();
@@ -83,6 +87,9 @@ class AsyncWire {
     boolean isReady();
     // 0 - success of last op, !=0 various errors
     uint8_t getStatus();
+    // callback run from twi interrupt when async op ends, NULL to detach.
+    // keep it short, e.g. TM.postTask(id) to wake task waiting for the op
+    void onComplete(void (*callback)(void));
 
 #ifdef ASYNC_DEBUG_METHODS
     // get status of underlying library
@@ -56,6 +56,8 @@ static volatile uint8_t twi_asyncStatus;        // async operation status
 
 static volatile uint8_t twi_event;              // last interrupt event received
 
+static void (*twi_onComplete)(void);            // async completion handler
+
 /* 
  * Function twi_init
  * Desc     readys twi pins and sets twi bitrate
@@ -103,6 +105,19 @@ void twi_reply(uint8_t ack)
   }
 }
 
+/* 
+ * Function twi_complete
+ * Desc     notifies completion handler that async operation ended
+ * Input    none
+ * Output   none
+ */
+static void twi_complete(void)
+{
+  if (twi_onComplete) {
+    twi_onComplete();
+  }
+}
+
 /* 
  * Function twi_stop
  * Desc     relinquishes bus master status
@@ -117,6 +132,7 @@ void twi_stop(void)
   if (twi_asyncStatus) {
     // mark async as stop pending
     twi_asyncStatus = TWI_AWAIT_STOP;
+    twi_complete();
   } else {
     // wait for stop condition to be executed on bus
     // TWINT is not set after a stop condition!
@@ -143,6 +159,7 @@ void twi_releaseBus(void)
   // update twi state and async state
   twi_state = TWI_READY;
   twi_asyncStatus = TWI_COMPLETE;
+  twi_complete();
 }
 
 // schedule data for sending
@@ -323,6 +340,10 @@ uint8_t twi_lastAsyncOpStatus(void)
   }
 }
 
+void twi_attachCompleteHandler(void (*function)(void)) {
+  twi_onComplete = function;
+}
+
 uint8_t twi_status(void) {
   return twi_state;
 }
@@ -368,6 +389,7 @@ SIGNAL(TWI_vect)
             TWCR = _BV(TWINT) | _BV(TWSTA)| _BV(TWEN) ;
             twi_state = TWI_READY;
             twi_asyncStatus = TWI_COMPLETE;
+            twi_complete();
           }
         } else {
           // start receiver
@@ -419,6 +441,7 @@ SIGNAL(TWI_vect)
         TWCR = _BV(TWINT) | _BV(TWSTA)| _BV(TWEN) ;
         twi_state = TWI_READY;
         twi_asyncStatus = TWI_COMPLETE;
+        twi_complete();
       }    
       break;
     case TW_MR_SLA_NACK: // address sent, nack received
@@ -72,6 +72,10 @@
   // last operation status
   // see async statuses in this file for possible error values
   uint8_t twi_lastAsyncOpStatus(void);
+
+  // function called from interrupt when async operation ends, 0 to detach
+  // stop condition may still be on the bus, twi_lastAsyncOpStatus tells
+  void twi_attachCompleteHandler(void (*)(void));
   
   // current transmission status, useful for debugging
   uint8_t twi_status(void);
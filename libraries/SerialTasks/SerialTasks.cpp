@@ -7,10 +7,10 @@ void SerialReaderTask::init(byte *aBuffer, void (*aFunction)(int size)) {
 }
 
 void SerialReaderTask::start(byte id) {
-  TM.addTask(id, SerialInTrigger.trigger(), this);
+  TM.addTask(id, SerialInTrigger.trigger(), dispatch, this);
 }
 
-void SerialReaderTask::doTask(Task *task, byte trigger, unsigned long time) {
+void SerialReaderTask::doTask(Task *task, byte trigger, TaskTime time) {
   int incoming = Serial.read();
   if (incoming=='\n' || incoming=='\r' || packetSize==80) {
     // end packet
@@ -24,72 +24,111 @@ void SerialReaderTask::doTask(Task *task, byte trigger, unsigned long time) {
 SerialReleaseTask ReleaseTask = SerialReleaseTask();
 
 void SerialResponseTask::start(byte id, int aValue) {
-  value = aValue;
-  TM.addTask(id, SerialOutSemaphore.trigger(), this);
+  Task *task = TM.addTask(id, SerialOutSemaphore.trigger(), dispatch, this);
+  if (task) *task->state<int>() = aValue;
 }
 
 void SerialResponseTask::start(Task *actionTask, int aValue) {
-  value = aValue;
+  *actionTask->state<int>() = aValue;
   actionTask->trigger = SerialOutSemaphore.trigger();
-  actionTask->handler = this;
+  actionTask->setFunction(dispatch, this);
+  TM.updateTask(actionTask);
 }
 
-void SerialResponseTask::doTask(Task *task, byte trigger, unsigned long time) {
+void SerialResponseTask::doTask(Task *task, byte trigger, TaskTime time) {
   SerialOutSemaphore.aquire();
   Serial.print("t ");
   Serial.print(task->id);
   Serial.print(' ');
-  Serial.println(value);
-  ReleaseTask.start(task, 100); // 1 byte/ms on 9600, 64 byte buffer max
+  Serial.println(*task->state<int>());
+  ReleaseTask.start(task, TASK_MS(100)); // 1 byte/ms on 9600, 64 byte buffer max
 }
 
-void SerialReleaseTask::start(Task *task, unsigned short delay) {
+void SerialReleaseTask::start(Task *task, TaskTime delay) {
   task->trigger = TIME_TRIGGER;
-  task->time = millis() + delay; 
-  task->handler = this;
+  task->time = TM.now() + delay;
+  task->setFunction(dispatch, this);
+  TM.updateTask(task);
 }
 
-void SerialReleaseTask::doTask(Task *task, byte trigger, unsigned long time) {
+void SerialReleaseTask::doTask(Task *task, byte trigger, TaskTime time) {
   task->clear();
   SerialOutSemaphore.release();
 }
 
-void PacketSendTask::start(byte id, byte *aBuffer, unsigned short aPacketSize, 
-                           unsigned short aBufferLength, unsigned long aTimePeriod) {
-  ptr = 0;
-  buffer = aBuffer;
-  packetSize = aPacketSize;
-  bufferSize = aBufferLength;
-  timeStep = aTimePeriod;
-  TM.addTask(id, SerialOutSemaphore.trigger(), this);
+boolean PacketSendTask::start(byte id, byte *aBuffer, unsigned short aPacketSize, 
+                              unsigned short aBufferLength, TaskTime aTimePeriod) {
+  Task *task = TM.addTask(id, SerialOutSemaphore.trigger(), dispatch, this);
+  if (!task) return false;
+  State *state = TaskStates.take<State>(task, dispatch, this);
+  if (!state) {
+    TM.removeTask(id);
+    return false;
+  }
+  state->ptr = 0;
+  state->buffer = aBuffer;
+  state->packetSize = aPacketSize;
+  state->bufferSize = aBufferLength;
+  state->timeStep = aTimePeriod;
+  return true;
 }
 
-void PacketSendTask::doTask(Task *task, byte trigger, unsigned long time) {
-  if (ptr==0) {
+void PacketSendTask::doTask(Task *task, byte trigger, TaskTime time) {
+  State *state = TaskStates.of<State>(task);
+  if (state->ptr==0) {
     // begin packet
     SerialOutSemaphore.aquire();
     task->trigger = TIME_TRIGGER;
-    task->time = millis();
+    task->time = TM.now();
     Serial.print("t ");
     Serial.print(task->id);
   }
-  int endPtr = ptr + packetSize;
-  if (endPtr>bufferSize) endPtr = bufferSize;
-  for(;ptr<endPtr;ptr++) {
+  int endPtr = state->ptr + state->packetSize;
+  if (endPtr>state->bufferSize) endPtr = state->bufferSize;
+  for(;state->ptr<endPtr;state->ptr++) {
     Serial.print(' ');
-    Serial.print(buffer[ptr]);
+    Serial.print(state->buffer[state->ptr]);
   }
-  if (ptr==bufferSize) {
+  if (state->ptr==state->bufferSize) {
     Serial.println();
     // last packet, we need to release serial after timeout
-    ReleaseTask.start(task, timeStep);
+    ReleaseTask.start(task, state->timeStep);
   } else {
-    task->time += timeStep;
+    task->time += state->timeStep;
+  }
+}
+
+#ifdef TASK_TRACE
+// records per chunk, 4+6*8 bytes fit serial tx buffer
+#define TRACE_CHUNK (8)
+
+void TraceSendTask::start(byte id, TaskTime timePeriod) {
+  timeStep = timePeriod;
+  Task *task = TM.addTask(id, TIME_TRIGGER, timePeriod, dispatch, this);
+  if (!task) return;
+  TASK_RESUME(task) = 0;
+  taskTraceIgnore(id);
+}
+
+void TraceSendTask::doTask(Task *task, byte trigger, TaskTime time) {
+  TASK_BEGIN();
+  for(;;) {
+    if (taskTracePending()) {
+      TASK_AQUIRE(&SerialOutSemaphore);
+      taskTraceWrite(TRACE_CHUNK);
+      TASK_SLEEP(timeStep);
+      SerialOutSemaphore.release();
+    }
+    TASK_SLEEP(timeStep);
   }
+  TASK_END();
 }
+#endif
 
 void SerialTrigger::init(byte tag) {
   resourceTag = tag;
+  // serial is only polled at beginning of loop, nothing to update after tasks
+  tracked = true;
   TM.registerTrigger(this);
 }
 
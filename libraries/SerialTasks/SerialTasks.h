@@ -3,6 +3,9 @@
 
 #include <TaskManager.h>
 #include <Triggers.h>
+#ifdef TASK_TRACE
+#include <TaskCoroutine.h>
+#endif
 
 class SerialTrigger : public Trigger {
   byte resourceTag;
@@ -20,7 +23,7 @@ class SerialTrigger : public Trigger {
     virtual byte updateTrigger(byte event);
 };
 
-class SerialReaderTask : public TaskHandler {
+class SerialReaderTask : public StaticTaskHandler<SerialReaderTask> {
   // buffer for command reading
   byte *serialBuffer;
   // bytes already read
@@ -31,41 +34,62 @@ class SerialReaderTask : public TaskHandler {
   public:
     void init(byte *buffer, void (*function)(int size));
     void start(byte id);
-    virtual void doTask(Task *task, byte trigger, unsigned long time);
+    void doTask(Task *task, byte trigger, TaskTime time);
 };
 
-// create one for each task needing response
-class SerialResponseTask : public TaskHandler {
-  int value;
-  
+// value is kept in task, one object serves all responses
+class SerialResponseTask : public StaticTaskHandler<SerialResponseTask> {
   public:
     void start(byte id, int value);
     void start(Task *actionTask, int value);
-    virtual void doTask(Task *task, byte trigger, unsigned long time);
+    void doTask(Task *task, byte trigger, TaskTime time);
+};
+
+class SerialReleaseTask : public StaticTaskHandler<SerialReleaseTask> {
+
+  public:
+    // delay in clock ticks, see TASK_MS
+    void start(Task *actionTask, TaskTime delay);
+    void doTask(Task *task, byte trigger, TaskTime time);
 };
 
-class SerialReleaseTask : public TaskHandler {
+// send progress takes an entry of TaskStates until buffer is sent
+class PacketSendTask : public StaticTaskHandler<PacketSendTask> {
+  struct State {
+    byte *buffer;
+    TaskTime       timeStep;      // how often to send bytes
+    unsigned short ptr;           // current send pointer
+    unsigned short packetSize;    // bytes send in one packet
+    unsigned short bufferSize;    // number of bytes to send
+  };
 
   public:
-    void start(Task *actionTask, unsigned short delay);
-    virtual void doTask(Task *task, byte trigger, unsigned long time);
+    // false if task couldn't be added or TaskStates are all taken
+    boolean start(byte id, byte *buffer, unsigned short packetSize, unsigned short bufferLength, TaskTime timePeriod);
+    void doTask(Task *task, byte trigger, TaskTime time);
 };
 
-class PacketSendTask : public TaskHandler {
-  byte *buffer;
-  unsigned short ptr;           // current send pointer
-  unsigned short packetSize;    // bytes send in one packet
-  unsigned short bufferSize;    // number of bytes to send
-  unsigned long  timeStep;      // how often to send bytes
+#ifdef TASK_TRACE
+// writes trace records in small chunks while holding serial semaphore, so
+// they never interleave with text of other tasks. resume point is kept in
+// task. its own runs are left out of trace, see taskTraceIgnore, so it only
+// takes serial for records of others
+class TraceSendTask : public StaticTaskHandler<TraceSendTask> {
+  // how often to check for records, also time given to serial to drain chunk
+  TaskTime timeStep;
 
   public:
-    void start(byte id, byte *buffer, unsigned short packetSize, unsigned short bufferLength, unsigned long timePeriod);
-    virtual void doTask(Task *task, byte trigger, unsigned long time);
+    void start(byte id, TaskTime timePeriod);
+    void doTask(Task *task, byte trigger, TaskTime time);
 };
+#endif
 
 extern SerialTrigger SerialInTrigger;
 extern SerialReaderTask SerialTask;
 extern ResourceTrigger SerialOutSemaphore;
 extern PacketSendTask PacketTask;
+// releases SerialOutSemaphore once a send is done, register it with snapshot
+// along with senders
+extern SerialReleaseTask ReleaseTask;
 
 #endif
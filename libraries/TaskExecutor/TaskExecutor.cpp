@@ -0,0 +1,188 @@
+#include <TaskExecutor.h>
+
+#if !defined(__AVR__) && !defined(ARDUINO)
+
+// task waits this long for its worker, posting wakes it sooner. only a
+// worker that gave up posting at stop leaves it to timeout
+#define EXECUTOR_PARK TASK_MS(1000)
+
+TaskExecutor::TaskExecutor() : queued(0), stopping(false), nextWorker(0) {
+  byte i;
+  for(i=0;i<EXECUTOR_JOBS;i++) jobs[i].state = JOB_FREE;
+}
+
+TaskExecutor::~TaskExecutor() {
+  stop();
+}
+
+void TaskExecutor::init(unsigned int threads) {
+  if (!workers.empty()) return;
+  if (!threads) threads = std::thread::hardware_concurrency();
+  if (!threads) threads = 1;
+  stopping = false;
+  unsigned int i;
+  for(i=0;i<threads;i++) workers.push_back(new Worker());
+  // lines are all in place before any worker looks for work
+  for(i=0;i<threads;i++) workers[i]->thread = std::thread(&TaskExecutor::work, this, i);
+}
+
+void TaskExecutor::stop() {
+  if (workers.empty()) return;
+  {
+    std::lock_guard<std::mutex> idle(idleLock);
+    stopping = true;
+  }
+  wake.notify_all();
+  unsigned int i;
+  for(i=0;i<workers.size();i++) workers[i]->thread.join();
+  for(i=0;i<workers.size();i++) delete workers[i];
+  workers.clear();
+}
+
+boolean TaskExecutor::taken(byte index) {
+  Job *job = jobs + index;
+  byte state = job->state.load(std::memory_order_acquire);
+  if (state==JOB_FREE) return false;
+  if (state==JOB_QUEUED) return true;
+  Task *task = TM.findTask(job->id);
+  if (task && task->function==dispatch && task->context==this && *task->state<byte>()==index) {
+    return true;
+  }
+  // task was removed, job is taken back here instead of by loop
+  if (state==JOB_DONE && job->resource) job->resource->release();
+  job->state = JOB_FREE;
+  return false;
+}
+
+boolean TaskExecutor::start(byte id, byte trigger, TaskTime invocationDelay,
+                            Task::Function function, void *context, ResourceTrigger *resource) {
+  byte i;
+  for(i=0;i<EXECUTOR_JOBS;i++) {
+    if (!taken(i)) break;
+  }
+  if (i==EXECUTOR_JOBS) return false;
+  Task *task = TM.addTask(id, trigger, invocationDelay, dispatch, this);
+  if (!task) return false;
+  Job *job = jobs + i;
+  memset(&job->copy, 0, sizeof(job->copy));
+  job->copy.setFunction(function, context);
+  job->copy.id = id;
+  job->copy.trigger = trigger;
+  job->copy.time = task->time;
+  job->copy.priority = task->priority;
+  job->id = id;
+  job->function = function;
+  job->resource = resource;
+  job->state = JOB_IDLE;
+  *task->state<byte>() = i;
+  return true;
+}
+
+unsigned int TaskExecutor::running() {
+  unsigned int count = 0;
+  byte i;
+  for(i=0;i<EXECUTOR_JOBS;i++) {
+    if (jobs[i].state==JOB_QUEUED) count++;
+  }
+  return count;
+}
+
+void TaskExecutor::doTask(Task *task, byte trigger, TaskTime time) {
+  Job *job = jobs + *task->state<byte>();
+  byte state = job->state.load(std::memory_order_acquire);
+  if (state==JOB_IDLE) {
+    // posted by worker after loop already took job back
+    if (!task->matches(trigger, time)) return;
+    if (job->resource) {
+      if (!job->resource->isOn()) {
+        // back once resource is free, own trigger is kept in copy
+        task->trigger = job->resource->trigger();
+        return;
+      }
+      job->resource->aquire();
+    }
+    if (workers.empty()) {
+      // no workers, run in loop
+      job->function(&job->copy, trigger, time);
+      state = JOB_DONE;
+    } else {
+      job->runTrigger = trigger;
+      job->runTime = time;
+      job->state = JOB_QUEUED;
+      Worker *worker = workers[nextWorker];
+      nextWorker = (nextWorker+1) % workers.size();
+      {
+        std::lock_guard<std::mutex> line(worker->lock);
+        worker->jobs.push_back(job);
+      }
+      {
+        std::lock_guard<std::mutex> idle(idleLock);
+        queued++;
+      }
+      wake.notify_one();
+    }
+  }
+  if (state!=JOB_DONE) {
+    // worker posts task once function returns
+    task->trigger = TIME_TRIGGER;
+    task->time = TM.now() + EXECUTOR_PARK;
+    return;
+  }
+  if (job->resource) job->resource->release();
+  task->trigger = job->copy.trigger;
+  task->time = job->copy.time;
+  if (!task->trigger) {
+    job->state = JOB_FREE;
+    task->clear();
+  } else {
+    job->state = JOB_IDLE;
+  }
+}
+
+TaskExecutor::Job* TaskExecutor::take(unsigned int index) {
+  unsigned int i;
+  for(i=0;i<workers.size();i++) {
+    Worker *worker = workers[(index+i) % workers.size()];
+    std::lock_guard<std::mutex> line(worker->lock);
+    if (worker->jobs.empty()) continue;
+    Job *job;
+    if (!i) {
+      job = worker->jobs.front();
+      worker->jobs.pop_front();
+    } else {
+      job = worker->jobs.back();
+      worker->jobs.pop_back();
+    }
+    queued--;
+    return job;
+  }
+  return NULL;
+}
+
+void TaskExecutor::run(Job *job) {
+  // job could be reused as soon as it is done
+  byte id = job->id;
+  job->function(&job->copy, job->runTrigger, job->runTime);
+  job->state.store(JOB_DONE, std::memory_order_release);
+  std::lock_guard<std::mutex> post(postLock);
+  while (!TM.postTask(id)) {
+    // ring is full, loop empties it unless it is stopping too
+    if (stopping) return;
+    std::this_thread::yield();
+  }
+}
+
+void TaskExecutor::work(unsigned int index) {
+  while (true) {
+    Job *job = take(index);
+    if (job) {
+      run(job);
+      continue;
+    }
+    std::unique_lock<std::mutex> idle(idleLock);
+    wake.wait(idle, [this] { return queued>0 || stopping; });
+    if (stopping && queued<=0) return;
+  }
+}
+
+#endif
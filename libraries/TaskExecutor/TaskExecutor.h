@@ -0,0 +1,100 @@
+#ifndef TASK_EXECUTOR_INCLUDED
+#define TASK_EXECUTOR_INCLUDED
+
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <Triggers.h>
+
+// host builds only, boards have no threads
+#if !defined(__AVR__) && !defined(ARDUINO)
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// function tasks one executor runs at once
+#ifndef EXECUTOR_JOBS
+#define EXECUTOR_JOBS (16)
+#endif
+
+// runs function tasks on a pool of worker threads, while loop of TM and
+// everything else stays on its thread. task is dispatched by TM as usual,
+// its function then runs on a worker with a copy of task and loop goes on.
+// once it returns, trigger, time and state it set on copy are taken back
+// by task in next loop, so function keeps or clears task as it would in
+// loop. function must not call TM or touch state other tasks use, unless
+// they share a resource: resource is aquired on loop thread before function
+// is handed to a worker and released after it is taken back, so jobs of one
+// resource never overlap. workers post finished tasks with TM.postTask, so
+// no other thread or interrupt may post while executor runs. each worker
+// takes jobs from its own line and steals from other lines when it runs dry.
+// job of a removed task is freed by start once its function returned
+class TaskExecutor : public StaticTaskHandler<TaskExecutor> {
+  enum {
+    JOB_FREE,
+    // waits in loop for trigger, time or resource
+    JOB_IDLE,
+    // handed to workers
+    JOB_QUEUED,
+    // returned, waits for loop to take it back
+    JOB_DONE
+  };
+
+  struct Job {
+    // task function sees, its state is kept between runs
+    Task copy;
+    Task::Function function;
+    // id of task, copy could be cleared by function
+    byte id;
+    ResourceTrigger *resource;
+    byte runTrigger;
+    TaskTime runTime;
+    std::atomic<byte> state;
+  };
+
+  struct Worker {
+    std::thread thread;
+    std::mutex lock;
+    std::deque<Job*> jobs;
+  };
+
+  Job jobs[EXECUTOR_JOBS];
+  std::vector<Worker*> workers;
+  // wakes idle workers
+  std::mutex idleLock;
+  std::condition_variable wake;
+  std::atomic<int> queued;
+  std::atomic<boolean> stopping;
+  unsigned int nextWorker;
+  // TM takes posts from one producer at a time
+  std::mutex postLock;
+
+  void work(unsigned int index);
+  // own line first, then others from their far end
+  Job* take(unsigned int index);
+  void run(Job *job);
+  // false if job is free or its task is gone
+  boolean taken(byte index);
+
+  public:
+    TaskExecutor();
+    ~TaskExecutor();
+    // start threads workers, 0 for one per core
+    void init(unsigned int threads = 0);
+    // join workers, tasks still running are taken back first
+    void stop();
+    // add function task run on workers, context is passed in copy.
+    // resource, if set, is held while function runs. false if task
+    // couldn't be added or all jobs are taken
+    boolean start(byte id, byte trigger, TaskTime invocationDelay,
+                  Task::Function function, void *context, ResourceTrigger *resource = NULL);
+    // functions running or waiting for a worker
+    unsigned int running();
+    void doTask(Task *task, byte trigger, TaskTime time);
+};
+
+#endif
+
+#endif
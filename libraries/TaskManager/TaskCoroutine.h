@@ -0,0 +1,62 @@
+#ifndef TASK_COROUTINE_INCLUDED
+#define TASK_COROUTINE_INCLUDED
+
+#include <TaskManager.h>
+
+// multi step handlers written as one doTask body. each wait stores where to
+// resume in task state and returns to loop, the task is dispatched again
+// when its trigger or time matches and body continues after the wait.
+// nothing is allocated and one handler object runs any number of tasks
+//
+//   class Blink : public StaticTaskHandler<Blink> {
+//     public:
+//       void start(byte id) {
+//         Task *task = TM.addTask(id, TIME_TRIGGER, dispatch, this);
+//         if (task) TASK_RESUME(task) = 0;
+//       }
+//       void doTask(Task *task, byte trigger, TaskTime time) {
+//         TASK_BEGIN();
+//         TASK_AQUIRE(&SerialOutSemaphore);
+//         Serial.println("on");
+//         TASK_SLEEP(TASK_MS(500));
+//         SerialOutSemaphore.release();
+//         TASK_END();
+//       }
+//   };
+//
+// locals don't survive a wait, keep state of a task in its state after the
+// resume point, shared state in the handler. waits can't be inside a switch
+// statement of the body. doTask parameters must be named task and time
+
+// resume point of a coroutine task, 0 starts from the beginning
+typedef unsigned short TaskResume;
+
+// resume point of task, first bytes of its state. set to 0 when task starts
+#define TASK_RESUME(task) (*(task)->state<TaskResume>())
+
+#define TASK_BEGIN() switch (TASK_RESUME(task)) { case 0:
+
+// give other tasks a turn, resume in next loop with same trigger and time
+#define TASK_YIELD() \
+  do { TASK_RESUME(task) = __LINE__; return; case __LINE__:; } while (0)
+
+// wait for any of the trigger bits
+#define TASK_WAIT(mask) \
+  do { task->trigger = (mask); TASK_YIELD(); } while (0)
+
+// wait delay clock ticks from time task was dispatched at
+#define TASK_SLEEP(delay) \
+  do { task->time = time + (delay); TASK_WAIT(TIME_TRIGGER); } while (0)
+
+// wait until clock time, e.g. task->time + period for steps without drift
+#define TASK_SLEEP_UNTIL(at) \
+  do { task->time = (at); TASK_WAIT(TIME_TRIGGER); } while (0)
+
+// wait for resource trigger and take it. release is up to the body
+#define TASK_AQUIRE(resource) \
+  do { TASK_WAIT((resource)->trigger()); (resource)->aquire(); } while (0)
+
+// body finished, task is removed
+#define TASK_END() } TASK_RESUME(task) = 0; task->clear(); return
+
+#endif
@@ -1,125 +1,156 @@
 #include <TaskManager.h>
 
-boolean Task::matches(byte aTrigger, unsigned long aTime) {
-  if (!(aTrigger & trigger)) return false;
-  long timeframe = aTime - time;
-  return   !(trigger & TIME_TRIGGER) 
-         || ((trigger & TIME_TRIGGER) && timeframe>=0 && timeframe<LATE_TIME_THRESHOLD);
-}
+#if defined(__AVR__)
+#include <avr/sleep.h>
+#elif !defined(ARDUINO)
+#include <time.h>
+#endif
 
-void Task::clear() {
-  id = 0;
-  trigger = 0;
+void taskSleep(TaskTime timeout) {
+#if defined(__AVR__)
+  // idle mode keeps timers and uart running, timer0 wakes cpu every ms
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_mode();
+#elif !defined(ARDUINO)
+  struct timespec pause;
+  pause.tv_sec = timeout/TASK_MS(1000);
+  pause.tv_nsec = (timeout%TASK_MS(1000))*(1000000L/TASK_TICKS_PER_MS);
+  nanosleep(&pause, NULL);
+  // shim clock only moves when stepped, time slept passes on it too
+  shimAdvanceMicros((unsigned long)timeout*(1000/TASK_TICKS_PER_MS));
+#endif
 }
 
-void TaskManager::init() {
-  // clean triggers so they arent triggered
-  int i;
-  for(i=0;i<TASK_QUEUE_SIZE;i++) {
-    queue[i].clear();
+#if defined(TASK_PROFILING) || defined(TASK_TRACE)
+void taskWriteLong(unsigned long value) {
+  byte i;
+  for(i=0;i<4;i++) {
+    Serial.write((byte)value);
+    value >>= 8;
   }
 }
+#endif
 
-Task* TaskManager::addTaskInternal(byte id, byte trigger, unsigned long firstInvocation, TaskHandler *handler) {
-  int i;
-  for(i=0;i<TASK_QUEUE_SIZE;i++) {
-    if (!queue[i].id) {
-      queue[i].id = id;
-      queue[i].trigger = trigger;
-      queue[i].handler = handler;
-      queue[i].time = firstInvocation;
-      return queue+i;
-    }
-  }
-  return NULL;
+#ifdef TASK_TRACE
+static TraceRecord traceRing[TASK_TRACE_SIZE];
+// written by taskTrace in any context, read by taskTraceWrite in loop
+static volatile byte traceHead;
+static volatile byte traceTail;
+static volatile byte traceDropped;
+static volatile boolean tracePaused;
+static byte traceIgnoredId;
+
+void taskTraceIgnore(byte id) {
+  traceIgnoredId = id;
 }
 
-Task* TaskManager::addTask(byte id, byte trigger, unsigned long invocationDelay, TaskHandler *handler) {
-  return addTaskInternal(id, trigger | TIME_TRIGGER, millis()+invocationDelay, handler);
+byte taskTraceIgnored() {
+  return traceIgnoredId;
 }
 
-Task* TaskManager::addTask(byte id, byte trigger, TaskHandler *handler) {
-  return addTaskInternal(id, trigger, 0, handler);
+void taskTracePause(boolean paused) {
+  tracePaused = paused;
 }
 
-void TaskManager::removeTask(byte id) {
-  int i;
-  for(i=0;i<TASK_QUEUE_SIZE;i++) {
-    if (queue[i].trigger && queue[i].id==id) {
-      queue[i].clear();
-      return;
-    }
+void taskTrace(byte type, byte data) {
+  if (tracePaused) return;
+#if defined(__AVR__)
+  // interrupts could record too
+  byte sreg = SREG;
+  cli();
+#endif
+  byte head = traceHead;
+  byte next = (head+1) & (TASK_TRACE_SIZE-1);
+  if (next==traceTail) {
+    if (traceDropped!=0xFF) traceDropped++;
+  } else {
+    TraceRecord *record = traceRing + head;
+    record->type = type;
+    record->data = data;
+    record->time = TASK_TRACE_CLOCK();
+    traceHead = next;
   }
+#if defined(__AVR__)
+  SREG = sreg;
+#endif
 }
 
-void TaskManager::writeDebugReportSync() {
-  Serial.println("Queue report:");
-  Serial.print("Time : ");
-  Serial.println(millis());
-  int i;
-  for(i=0;i<TASK_QUEUE_SIZE;i++) {
-    Serial.print(i);
-    Serial.print(" : ");
-    if (queue[i].trigger) {
-      Serial.print(queue[i].id);
-      Serial.print(",");
-      Serial.print(queue[i].trigger, HEX);
-      Serial.print(",");
-      Serial.println(queue[i].time);
-    } else {
-      Serial.println("----");
-    }
-  }
-  Serial.println("Triggers ");
-  for(i=0;i<MAX_TRIGGERS && triggers[i];i++) {
-    Serial.print(triggers[i]->trigger(), HEX);
-    Serial.print(':');
-    Serial.println(triggers[i]->isOn());
-  }
+byte taskTracePending() {
+  return (traceHead - traceTail) & (TASK_TRACE_SIZE-1);
 }
 
-void TaskManager::registerTrigger(Trigger *trigger) {
-  int i;
-  for(i=0;i<MAX_TRIGGERS;i++) {
-    if (!triggers[i]) {
-      triggers[i] = trigger;
-      return;
-    }
+void taskTraceWrite(byte count) {
+  byte pending = taskTracePending();
+  if (count>pending) count = pending;
+#if defined(__AVR__)
+  byte sreg = SREG;
+  cli();
+#endif
+  byte dropped = traceDropped;
+  traceDropped = 0;
+#if defined(__AVR__)
+  SREG = sreg;
+#endif
+  Serial.write(TRACE_REPORT_TAG);
+  Serial.write(TRACE_REPORT_VERSION);
+  Serial.write(count);
+  Serial.write(dropped);
+  byte tail = traceTail;
+  while (count--) {
+    TraceRecord *record = traceRing + tail;
+    Serial.write(record->type);
+    Serial.write(record->data);
+    taskWriteLong(record->time);
+    tail = (tail+1) & (TASK_TRACE_SIZE-1);
   }
+  traceTail = tail;
 }
+#endif
 
-byte TaskManager::getEvents() {
-  byte trigger = TIME_TRIGGER;
-  int i;
-  for(i=0;i<MAX_TRIGGERS && triggers[i];i++) {
-    trigger = triggers[i]->setTrigger(trigger);
-  }
-  return trigger;
+TaskManager TM;
+
+TaskStatePool::TaskStatePool() {
+  memset(owners, 0, sizeof(owners));
+}
+
+boolean TaskStatePool::taken(byte entry) {
+  Owner *owner = owners+entry;
+  Task *task = owner->task;
+  return task && task->trigger && task->function==owner->function
+      && task->context==owner->context && *task->state<byte>()==entry;
 }
 
-byte TaskManager::updateEvents(byte trigger) {
-  int i;
-  for(i=0;i<MAX_TRIGGERS && triggers[i];i++) {
-    trigger = triggers[i]->updateTrigger(trigger);
+void* TaskStatePool::take(Task *task, TaskFunction function, void *context) {
+  byte entry = *task->state<byte>();
+  // task keeps its entry when it is started again
+  if (entry>=TASK_POOL_SIZE || owners[entry].task!=task) {
+    for(entry=0;entry<TASK_POOL_SIZE && taken(entry);entry++) {}
+    if (entry>=TASK_POOL_SIZE) return NULL;
   }
-  return trigger;
+  Owner *owner = owners+entry;
+  owner->task = task;
+  owner->function = function;
+  owner->context = context;
+  *task->state<byte>() = entry;
+  return entries[entry].data;
 }
-    
-void TaskManager::loop() {
-  // form trigger bits
-  unsigned long time = millis();
-  byte trigger = getEvents();
-  // find matching commands and dispatch
-  int matching = 0;
-  int i;
-  for(i=0;i<TASK_QUEUE_SIZE;i++) {
-    Task *current = queue + i;
-    if (current->trigger && current->matches(trigger, time)) {
-      current->handler->doTask(current, trigger, time);
-      matching++;
-      trigger = updateEvents(trigger);
-    }
+
+void* TaskStatePool::of(Task *task) {
+  byte entry = *task->state<byte>();
+  if (entry>=TASK_POOL_SIZE) return NULL;
+  Owner *owner = owners+entry;
+  // trigger is not checked, handler could ask on last run
+  if (owner->task!=task || owner->function!=task->function
+      || owner->context!=task->context) return NULL;
+  return entries[entry].data;
+}
+
+byte TaskStatePool::available() {
+  byte entry, count = 0;
+  for(entry=0;entry<TASK_POOL_SIZE;entry++) {
+    if (!taken(entry)) count++;
   }
+  return count;
 }
 
-TaskManager TM = TaskManager();
+TaskStatePool TaskStates;
@@ -2,76 +2,626 @@
 #define TASK_MANAGER_INCLUDED
 
 #include <Arduino.h>
+#ifndef ARDUINO
+#include <atomic>
+#endif
+
+// enable this to collect per task run times and lateness, see writeProfileReportSync
+// #define TASK_PROFILING
+
+// enable this to record dispatches, trigger, resource and twi events in a
+// ring drained by taskTraceWrite, see TraceSendTask in SerialTasks
+// #define TASK_TRACE
+
+// enable this to build library handlers without TaskHandler base and its vtable.
+// they are always dispatched through StaticTaskHandler direct calls
+// #define TASK_STATIC_HANDLERS
+
+// enable this to schedule on micros() instead of millis(). all task times and
+// delays are then in microseconds, use TASK_MS to convert from milliseconds
+// #define TASK_MICROS
+
+// enable this to run on a virtual clock set with setTime. idleLoop and runUntil
+// jump it to the next due task instead of sleeping, so long schedules run at
+// full speed on host. dispatch order is the one of real clock as long as
+// triggers only change by tasks
+// #define TASK_VIRTUAL_TIME
+
+// task times in clock ticks and signed distance between two of them.
+// boards keep unsigned long of millis(), host takes 32 bits as well instead
+// of its 64 bit long, so clocks wrap there like on boards
+#ifdef ARDUINO
+typedef unsigned long TaskTime;
+typedef long TaskSpan;
+#else
+typedef uint32_t TaskTime;
+typedef int32_t TaskSpan;
+#endif
+
+// TASK_CLOCK() can be defined for the whole build to schedule on another
+// time source, e.g. a stepped clock of a host build. define TASK_TICKS_PER_MS
+// with it
+#ifndef TASK_CLOCK
+#ifdef TASK_MICROS
+#define TASK_CLOCK()        micros()
+#define TASK_TICKS_PER_MS   (1000)
+#else
+#define TASK_CLOCK()        millis()
+#define TASK_TICKS_PER_MS   (1)
+#endif
+#endif
+#define TASK_MS(ms)         ((TaskTime)(ms)*TASK_TICKS_PER_MS)
+
+// time triggered task later than this is overrun, see Task::overrun
+#define LATE_TIME_THRESHOLD ((TaskSpan)TASK_MS(10000))
 
-#define LATE_TIME_THRESHOLD (10000)
+// overrun policies. loop dispatches an overrun task late unless it fails,
+// periodic handlers apply policy to steps missed by more than a period
+// replay every missed step back to back
+#define OVERRUN_CATCH_UP    (0)
+// drop missed steps and continue at next period
+#define OVERRUN_SKIP        (1)
+// one call for all missed steps, handler tells how many were missed
+#define OVERRUN_COALESCE    (2)
+// remove task at LATE_TIME_THRESHOLD and call overrun callback of manager
+#define OVERRUN_FAIL        (3)
+
+// sizes below shape TM and Task, which TaskManager.cpp and library sources
+// are compiled with. change them here or define them for the whole build,
+// a define in sketch alone leaves libraries with other layout
+
+// capacity of default TM manager, other managers set theirs as template arguments
+#ifndef TASK_QUEUE_SIZE
 #define TASK_QUEUE_SIZE     (10)
+#endif
 #define MAX_TRIGGERS        (10)
+// chains in task id index, power of two. by default each manager has one
+// per slot rounded up, so findTask walks about one slot, and managers of
+// more than 128 slots get 256, one per id
+// #define TASK_ID_BUCKETS     (16)
 
 #define TIME_TRIGGER        (0x01)
 
-class Trigger {
+// bytes of handler state each task carries, see BasicTask::state. enough
+// for a handle, a value or a coroutine resume point. handlers needing more
+// take an entry of TaskStates
+#ifndef TASK_STATE_SIZE
+#define TASK_STATE_SIZE     (sizeof(unsigned long))
+#endif
+// entries of TaskStates, tasks that run with bigger state at once: sweeps,
+// repeating timers and packet sends. 0 leaves only small state
+#ifndef TASK_POOL_SIZE
+#define TASK_POOL_SIZE      (4)
+#endif
+// bytes of one entry, fits state of every library handler
+#ifndef TASK_POOL_ENTRY_SIZE
+#define TASK_POOL_ENTRY_SIZE (2*sizeof(unsigned long)+4*sizeof(unsigned short)+2*sizeof(void*))
+#endif
+
+// events posted by interrupts and not yet taken by loop, power of two up to 128
+#ifndef TASK_EVENT_QUEUE_SIZE
+#define TASK_EVENT_QUEUE_SIZE (8)
+#endif
+// keeps event record and queue index writes in order. avr has single core
+// so compiler must not reorder. on host the indexes are atomics, whose
+// loads and stores already order records between threads
+#ifdef ARDUINO
+#define TASK_EVENT_BARRIER() __asm__ __volatile__("" ::: "memory")
+typedef volatile byte TaskEventIndex;
+#else
+#define TASK_EVENT_BARRIER()
+typedef std::atomic<byte> TaskEventIndex;
+#endif
+
+// dispatch classes, all tasks of a class run before the next class
+#ifndef TASK_PRIORITIES
+#define TASK_PRIORITIES     (3)
+#endif
+#define PRIORITY_HIGH       (0)
+#define PRIORITY_NORMAL     (1)
+#define PRIORITY_LOW        (TASK_PRIORITIES-1)
+
+#ifdef TASK_PROFILING
+// number of task ids profiled at once, 0 to match queue size
+#ifndef TASK_PROFILE_SIZE
+#define TASK_PROFILE_SIZE   (0)
+#endif
+// lateness buckets in clock ticks: 0, 1, 2-3, 4-7 ... up to LATE_TIME_THRESHOLD
+#ifdef TASK_MICROS
+#define PROFILE_LATE_BUCKETS (25)
+#else
+#define PROFILE_LATE_BUCKETS (15)
+#endif
+#define PROFILE_REPORT_TAG   ('P')
+#define PROFILE_REPORT_VERSION (1)
+
+struct TaskProfile {
+  // profiled task id, 0 for unused entry
+  byte id;
+  unsigned long calls;
+  // micros spent in doTask
+  unsigned long totalTime;
+  unsigned long maxTime;
+  // how late time triggered runs were, counts saturate
+  unsigned short late[PROFILE_LATE_BUCKETS];
+};
+#endif
+
+// loop time budget counters, see BasicTaskManager::setBudget
+struct TaskLoadStats {
+  // loops that ran out of budget
+  unsigned long overloads;
+  // runnable tasks left for next loop when budget ran out
+  unsigned long deferred;
+  // runnable tasks of shed classes skipped in loops after an overload or
+  // not reached when budget ran out
+  unsigned long shed;
+};
+
+#ifdef TASK_TRACE
+// records kept until written, power of two up to 128
+#ifndef TASK_TRACE_SIZE
+#define TASK_TRACE_SIZE     (32)
+#endif
+#ifndef TASK_TRACE_CLOCK
+#define TASK_TRACE_CLOCK()  micros()
+#endif
+#define TRACE_REPORT_TAG     ('T')
+#define TRACE_REPORT_VERSION (1)
+
+// record types, data is given for each
+// task id
+#define TRACE_TASK_START    (1)
+#define TRACE_TASK_END      (2)
+// low byte of trigger mask
+#define TRACE_TRIGGERS      (3)
+// resource trigger tag
+#define TRACE_AQUIRE        (4)
+#define TRACE_RELEASE       (5)
+// 7 bit device address, AsyncWire repeats these values as it records
+// without including this header
+#define TRACE_TWI_START     (6)
+#define TRACE_TWI_DONE      (7)
+
+struct TraceRecord {
+  byte type;
+  byte data;
+  // TASK_TRACE_CLOCK when recorded
+  unsigned long time;
+};
+
+// add record, safe in interrupts. dropped and counted when ring is full
+void taskTrace(byte type, byte data);
+// records not written yet
+byte taskTracePending();
+// dispatches of task id and everything recorded during them, e.g. its
+// resource and trigger changes, stay out of ring. TraceSendTask sets its
+// own id, so draining the ring doesn't fill it again. 0 for none
+void taskTraceIgnore(byte id);
+byte taskTraceIgnored();
+// while paused records are skipped, those of interrupts too
+void taskTracePause(boolean paused);
+// write up to count records to serial, little endian:
+// tag, version, record count, dropped records since last write
+// then per record type, data, time (4)
+void taskTraceWrite(byte count);
+#endif
+
+#if defined(TASK_PROFILING) || defined(TASK_TRACE)
+// little endian write to serial
+void taskWriteLong(unsigned long value);
+#endif
+
+// wait for interrupt or timeout in clock ticks, whichever comes first.
+// on host the shim clock is advanced by timeout
+void taskSleep(TaskTime timeout);
+
+// MaskT is the trigger bit mask type: byte, unsigned short or unsigned long
+template<class MaskT> class BasicTrigger {
+  protected:
+    // set by triggers that call changed() whenever their state moves. their
+    // updateTrigger then runs only after a change, others after every task
+    boolean tracked;
+    boolean dirty;
+
   public:
+    BasicTrigger() : tracked(false), dirty(false) {}
+    // state moved, update trigger after current task
+    void changed() { dirty = true; }
+    // updateTrigger if it could have moved
+    MaskT refresh(MaskT event) {
+      if (tracked && !dirty) return event;
+      dirty = false;
+      return updateTrigger(event);
+    }
+
     // this trigger is used for debugging log
     virtual boolean isOn() = 0;
-    virtual byte trigger() = 0;    
+    virtual MaskT trigger() = 0;
     // set trigger at the beginning of loop
-    virtual byte setTrigger(byte event) = 0;
+    virtual MaskT setTrigger(MaskT event) = 0;
     // update trigger after each task
-    virtual byte updateTrigger(byte event) = 0;
+    virtual MaskT updateTrigger(MaskT event) = 0;
 };
 
-class Task;
+template<class MaskT> class BasicTask;
 
-class TaskHandler {
+template<class MaskT> class BasicTaskHandler {
   public:
     // virtual method to implement in handlers
-    virtual void doTask(Task *task, byte trigger, unsigned long time) = 0;
+    virtual void doTask(BasicTask<MaskT> *task, MaskT trigger, TaskTime time) = 0;
 };
 
-class Task {
+template<class MaskT> class BasicTask {
   public:
-    // task id for management. must be unique, but no checks are done
+    // direct dispatch target, gets its object from context
+    typedef void (*Function)(BasicTask *task, MaskT trigger, TaskTime time);
+
+    // task id for management. must be unique and non zero, addTask refuses duplicates
     byte id;
     // event to match
-    byte trigger;
-    // time when trigger matches
-    unsigned long time;
-    // replaces command field
-    TaskHandler *handler;
+    MaskT trigger;
+    // clock time when trigger matches, see TASK_CLOCK
+    TaskTime time;
+    union {
+      // replaces command field, used when function is not set
+      BasicTaskHandler<MaskT> *handler;
+      // object for function
+      void *context;
+    };
+    // called instead of handler if set
+    Function function;
+    // dispatch class, PRIORITY_HIGH first. change with TaskManager::setPriority
+    byte priority;
+    // what happens when task runs late, OVERRUN_CATCH_UP by default
+    byte overrun;
+    // clock ticks task could run after time, so timers with overlapping
+    // windows wake loop once. change with TaskManager::setSlack, up to
+    // 65535 ticks
+    unsigned short slack;
+    // handler state kept in task, so one handler object can serve many tasks
+    union {
+      byte data[TASK_STATE_SIZE];
+      // alignment of state structs
+      unsigned long alignLong;
+      void *alignPointer;
+    } storage;
     
     // check for the match
-    boolean matches(byte trigger, unsigned long time);
+    boolean matches(MaskT trigger, TaskTime time);
+
+    // dispatch through virtual doTask of handler
+    void setHandler(BasicTaskHandler<MaskT> *handler);
+    // dispatch with direct function call
+    void setFunction(Function function, void *context);
+    
+    // storage seen as handler state struct
+    template<class State> State* state() {
+      static_assert(sizeof(State)<=TASK_STATE_SIZE, "increase TASK_STATE_SIZE");
+      return (State*)storage.data;
+    }
     
     // reset task
     void clear();
 };
 
-class TaskManager {
+// slot index type, wide enough to address every slot plus NO_TASK marker
+template<bool Wide> struct TaskIndexType {
+  typedef byte Type;
+};
+
+template<> struct TaskIndexType<true> {
+  typedef unsigned short Type;
+};
+
+// id index size for Tasks slots, smallest power of two that covers them
+template<unsigned int Tasks, unsigned int Buckets = 1, bool Covered = (Buckets>=Tasks || Buckets>=256)>
+struct TaskIdBuckets {
+  static const unsigned int Value = TaskIdBuckets<Tasks, Buckets*2>::Value;
+};
+
+template<unsigned int Tasks, unsigned int Buckets> struct TaskIdBuckets<Tasks, Buckets, true> {
+  static const unsigned int Value = Buckets;
+};
+
+// trigger bits or task activation posted from interrupt
+template<class MaskT> struct TaskEvent {
+  // task to run, 0 to raise trigger bits
+  byte id;
+  MaskT trigger;
+};
+
+// scheduler bookkeeping for a queue slot
+template<class Index> struct TaskLinks {
+  // neighbours in circular list slot is filed in
+  Index prev;
+  Index next;
+  // position in timer heap
+  Index heap;
+  // end of slack window of timer, heap key set when it is filed
+  TaskTime due;
+  // structure holding the slot
+  byte list;
+  // id slot is indexed under and next slot in same id chain
+  byte id;
+  Index idNext;
+};
+
+// task manager with storage sized at compile time. besides default TM a
+// second small manager could serve isr adjacent work, for example
+//   BasicTaskManager<4, 2, byte> FastTM;
+// handlers and triggers of a manager must use the same MaskT. library
+// handlers and triggers (TimerTasks, Triggers, SerialTasks, TaskSnapshot)
+// add their tasks to and register with TM only, a second manager runs
+// function tasks and handlers written for it
+// manager is not thread safe. loop and task management belong to one thread
+// or main program, only postEvent and postTask may come from one interrupt or
+// other thread. on host TaskExecutor runs function tasks of TM on worker
+// threads, loop and library handlers stay single threaded
+template<unsigned int Tasks, byte Triggers, class MaskT> class BasicTaskManager {
+  public:
+    typedef typename TaskIndexType<(Tasks>=255)>::Type Index;
+    typedef BasicTask<MaskT> TaskType;
+    typedef BasicTaskHandler<MaskT> HandlerType;
+    typedef BasicTrigger<MaskT> TriggerType;
+    typedef typename TaskType::Function FunctionType;
+
   private:
-    Task queue[TASK_QUEUE_SIZE];
+    static const Index NO_TASK = (Index)~0;
+    static const byte TRIGGER_BITS = sizeof(MaskT)*8;
+#ifdef TASK_ID_BUCKETS
+    static const unsigned int ID_BUCKETS = TASK_ID_BUCKETS;
+#else
+    static const unsigned int ID_BUCKETS = TaskIdBuckets<Tasks>::Value;
+#endif
+    // structure holding the slot, see TaskLinks::list
+    enum {
+      LIST_FREE,
+      LIST_TIMERS,
+      LIST_DEFERRED,
+      LIST_RUNNING,
+      // followed by one value per priority class
+      LIST_READY,
+      LIST_MIXED = LIST_READY+TASK_PRIORITIES,
+      // followed by one value per priority class and trigger bit
+      LIST_BUCKET = LIST_MIXED+TASK_PRIORITIES
+    };
+
+    TaskType queue[Tasks];
+    TaskLinks<Index> links[Tasks];
+    // time triggered tasks as binary min-heap on task time
+    Index timers[Tasks];
+    Index timerCount;
+    // due timers of each class in deadline order
+    Index ready[TASK_PRIORITIES];
+    // tasks waiting for a single non time trigger, one list per class and trigger bit
+    Index buckets[TASK_PRIORITIES][TRIGGER_BITS];
+    // tasks waiting for any of several triggers
+    Index mixed[TASK_PRIORITIES];
+    // tasks dispatched or added in current loop, filed when loop ends
+    Index deferred;
+    // unused slots
+    Index freeSlots;
+    // slots chained by hash of task id
+    Index ids[ID_BUCKETS];
+    boolean inLoop;
+    // task being dispatched
+    TaskType *running;
+    // micros loop could spend dispatching, 0 for no limit
+    unsigned long budget;
+    // first class skipped in loop after overload
+    byte shedPriority;
+    // class loop starts with, one behind class budget ran out in
+    byte resumePriority;
+    // last loop ran out of budget
+    boolean overloaded;
+    TaskLoadStats load;
+    // overrun tasks and missed periodic steps
+    unsigned long overruns;
+    // called for OVERRUN_FAIL tasks
+    void (*overrunCallback)(TaskType *task, TaskTime late);
+    // ring written by single interrupt producer and drained by loop. indexes
+    // are bytes so either side reads them atomically, atomics on host
+    TaskEvent<MaskT> posted[TASK_EVENT_QUEUE_SIZE];
+    TaskEventIndex eventHead;
+    TaskEventIndex eventTail;
     // triggers are external to task manager
-    Trigger *triggers[MAX_TRIGGERS];
+    TriggerType *triggers[Triggers];
+#ifdef TASK_TRACE
+    // last trigger mask recorded
+    MaskT tracedEvents;
 
-    byte getEvents();
-    byte updateEvents(byte status);
-    Task* addTaskInternal(byte id, byte trigger, unsigned long firstInvocation, TaskHandler *handler);
+    void traceEvents(MaskT events);
+#endif
+#ifdef TASK_PROFILING
+    static const unsigned int PROFILE_SIZE = TASK_PROFILE_SIZE ? TASK_PROFILE_SIZE : Tasks;
+    TaskProfile profiles[PROFILE_SIZE];
+    // runs of tasks that didn't fit in profiles
+    unsigned long unprofiledCalls;
+
+    void profile(byte id, boolean timed, TaskTime late, unsigned long runTime);
+#endif
+
+    MaskT getEvents();
+    MaskT updateEvents(MaskT status);
+#ifdef TASK_VIRTUAL_TIME
+    TaskTime virtualTime;
+
+    boolean skipIdle(TaskTime limit);
+#endif
+
+    TaskType* addTaskInternal(byte id, MaskT trigger, TaskTime firstInvocation, HandlerType *handler);
+
+    // list and heap maintenance
+    void append(Index *head, Index slot, byte list);
+    void unlink(Index *head, Index slot);
+    Index* head(byte list);
+    boolean before(Index a, Index b);
+    void siftUp(Index pos);
+    void siftDown(Index pos);
+    void pushTimer(Index slot);
+    void removeTimer(Index pos);
+    void file(Index slot);
+    void detach(Index slot);
+    void release(Index slot);
+    void indexId(Index slot);
+    void unindexId(Index slot);
+    MaskT dispatch(Index slot, MaskT trigger, TaskTime time);
+    MaskT waitingEvents();
+    unsigned int length(Index head);
+    unsigned int runnable(byte priority, MaskT trigger);
+    boolean post(byte id, MaskT trigger);
+    MaskT drainEvents();
 
   public:
+    BasicTaskManager();
     void init();
     
-    // manage tasks
-    Task* addTask(byte id, byte trigger, TaskHandler *handler);
-    Task* addTask(byte id, byte trigger, unsigned long invocationDelay, TaskHandler *handler);
+    // current scheduler clock
+    TaskTime now();
+
+    // manage tasks, delays are in clock ticks
+    TaskType* addTask(byte id, MaskT trigger, HandlerType *handler);
+    TaskType* addTask(byte id, MaskT trigger, TaskTime invocationDelay, HandlerType *handler);
+    TaskType* addTask(byte id, MaskT trigger, FunctionType function, void *context);
+    TaskType* addTask(byte id, MaskT trigger, TaskTime invocationDelay, FunctionType function, void *context);
     void removeTask(byte id);
+    // active task with id or NULL
+    TaskType* findTask(byte id);
+    // task whose doTask is running, NULL outside of dispatch
+    TaskType* runningTask();
+    // walk active tasks, NULL starts and ends the walk
+    TaskType* nextTask(TaskType *task);
+    // refile task after its trigger or time was changed outside of its own doTask
+    void updateTask(TaskType *task);
+    // move task to another dispatch class
+    void setPriority(TaskType *task, byte priority);
+    // let time triggered task run up to slack ticks late. loop wakes at
+    // earliest end of a window and runs then every timer whose window is
+    // open, so timers with overlapping windows share a wakeup. slack is at
+    // most 65535 ticks, about 65 ms with TASK_MICROS
+    void setSlack(TaskType *task, unsigned short slack);
+    // called with overrun task just removed, id and time are still set.
+    // task could be added again from callback
+    void onOverrun(void (*callback)(TaskType *task, TaskTime late));
+    // periodic handlers report missed steps
+    void addOverruns(unsigned short missed);
+    unsigned long overrunCount();
     void writeDebugReportSync();
+#ifdef TASK_PROFILING
+    // binary dump of task profiles, little endian:
+    // tag, version, entry count, bucket count, unprofiled calls (4)
+    // then per entry id, calls (4), total (4), max (4), late buckets (2 each)
+    void writeProfileReportSync();
+    void resetProfile();
+#endif
     
     // manage triggers
-    void registerTrigger(Trigger *trigger);
+    void registerTrigger(TriggerType *trigger);
+
+    // safe to call from one interrupt handler, loop picks events up before
+    // it polls triggers. false if event queue is full
+    // raise trigger bits for next loop only
+    boolean postEvent(MaskT trigger);
+    // run task with id in next loop whatever its trigger and time are
+    boolean postTask(byte id);
     
+    // limit time one loop spends dispatching. once spent, runnable tasks
+    // stay queued and tasks of same trigger take turns. next loop starts
+    // with class behind the one budget ran out in and comes back to higher
+    // classes after, so a busy class doesn't starve lower ones. 0 turns
+    // limit off
+    void setBudget(unsigned long micros);
+    // classes from priority on are skipped in loop following an overload,
+    // TASK_PRIORITIES to never shed
+    void setShedPriority(byte priority);
+    TaskLoadStats loadStats();
+    void resetLoadStats();
+
     // main loop
     void loop();
+    // earliest end of a timer window, false if only events can wake tasks
+    boolean nextWakeup(TaskTime *time);
+    // run loop then sleep until a task is due or a trigger tasks wait for comes on
+    void idleLoop();
+#ifdef TASK_VIRTUAL_TIME
+    // move virtual clock, e.g. to start of simulation
+    void setTime(TaskTime time);
+    // run tasks up to and including time. tasks that stay runnable keep
+    // virtual clock where it is
+    void runUntil(TaskTime time);
+#endif
+};
+
+// base for handlers dispatched without virtual call. Handler implements
+// non virtual doTask and schedules with dispatch and itself as context
+template<class Handler, class MaskT = byte> class StaticTaskHandler
+#ifndef TASK_STATIC_HANDLERS
+  : public BasicTaskHandler<MaskT>
+#endif
+{
+  public:
+    static void dispatch(BasicTask<MaskT> *task, MaskT trigger, TaskTime time) {
+      static_cast<Handler*>(task->context)->Handler::doTask(task, trigger, time);
+    }
+    // snapshot hook, see TaskSnapshot. state and TaskStates entry are
+    // saved as is, handlers that need fixups on restore hide this
+    static boolean snapshot(BasicTask<MaskT> *task, boolean restored) {
+      return true;
+    }
 };
 
+#include <TaskManagerImpl.h>
+
+// default manager
+typedef BasicTrigger<byte> Trigger;
+typedef BasicTask<byte> Task;
+typedef BasicTaskHandler<byte> TaskHandler;
+typedef Task::Function TaskFunction;
+typedef BasicTaskManager<TASK_QUEUE_SIZE, MAX_TRIGGERS, byte> TaskManager;
+
 extern TaskManager TM;
 
+// handler state too big for task state, entries shared by all handlers of
+// TM. task state starts with number of its entry. entry is taken until its
+// task ends or runs with other function or context than the one took it
+class TaskStatePool {
+  struct Owner {
+    Task *task;
+    TaskFunction function;
+    void *context;
+  };
+  union Entry {
+    byte data[TASK_POOL_ENTRY_SIZE];
+    // alignment of state structs
+    unsigned long alignLong;
+    void *alignPointer;
+  };
+
+  Entry entries[TASK_POOL_SIZE ? TASK_POOL_SIZE : 1];
+  Owner owners[TASK_POOL_SIZE ? TASK_POOL_SIZE : 1];
+
+  // owner still runs as it did when it took entry
+  boolean taken(byte entry);
+
+  public:
+    TaskStatePool();
+    // entry of task, the one it holds already if any. NULL if all are taken
+    void* take(Task *task, TaskFunction function, void *context);
+    // entry task took, NULL if it holds none
+    void* of(Task *task);
+    // entries not taken
+    byte available();
+
+    template<class State> State* take(Task *task, TaskFunction function, void *context) {
+      static_assert(sizeof(State)<=TASK_POOL_ENTRY_SIZE, "increase TASK_POOL_ENTRY_SIZE");
+      return (State*)take(task, function, context);
+    }
+    template<class State> State* of(Task *task) {
+      return (State*)of(task);
+    }
+};
+
+extern TaskStatePool TaskStates;
+
 #endif
@@ -0,0 +1,853 @@
+#ifndef TASK_MANAGER_IMPL_INCLUDED
+#define TASK_MANAGER_IMPL_INCLUDED
+
+// template definitions for TaskManager.h, not to be included directly
+
+#define TASK_MANAGER_TEMPLATE template<unsigned int Tasks, byte Triggers, class MaskT>
+#define TASK_MANAGER          BasicTaskManager<Tasks, Triggers, MaskT>
+
+template<class MaskT>
+boolean BasicTask<MaskT>::matches(MaskT aTrigger, TaskTime aTime) {
+  if (!(aTrigger & trigger)) return false;
+  TaskSpan timeframe = aTime - time;
+  return   !(trigger & TIME_TRIGGER) 
+         || ((trigger & TIME_TRIGGER) && timeframe>=0 && timeframe<LATE_TIME_THRESHOLD);
+}
+
+template<class MaskT>
+void BasicTask<MaskT>::setHandler(BasicTaskHandler<MaskT> *aHandler) {
+  handler = aHandler;
+  function = NULL;
+}
+
+template<class MaskT>
+void BasicTask<MaskT>::setFunction(Function aFunction, void *aContext) {
+  context = aContext;
+  function = aFunction;
+}
+
+template<class MaskT>
+void BasicTask<MaskT>::clear() {
+  id = 0;
+  trigger = 0;
+}
+
+TASK_MANAGER_TEMPLATE
+TASK_MANAGER::BasicTaskManager() {
+  // only here, triggers could be registered before init is called
+  memset(triggers, 0, sizeof(triggers));
+  init();
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::init() {
+  // clean triggers so they arent triggered
+  unsigned int i, j;
+  freeSlots = NO_TASK;
+  for(i=0;i<Tasks;i++) {
+    queue[i].clear();
+    append(&freeSlots, i, LIST_FREE);
+  }
+  for(i=0;i<TASK_PRIORITIES;i++) {
+    ready[i] = NO_TASK;
+    mixed[i] = NO_TASK;
+    for(j=0;j<TRIGGER_BITS;j++) {
+      buckets[i][j] = NO_TASK;
+    }
+  }
+  for(i=0;i<ID_BUCKETS;i++) {
+    ids[i] = NO_TASK;
+  }
+  timerCount = 0;
+  deferred = NO_TASK;
+  inLoop = false;
+  running = NULL;
+  budget = 0;
+  shedPriority = TASK_PRIORITIES;
+  resumePriority = 0;
+  overloaded = false;
+  resetLoadStats();
+  overruns = 0;
+#ifdef TASK_TRACE
+  tracedEvents = 0;
+#endif
+  overrunCallback = NULL;
+  eventHead = 0;
+  eventTail = 0;
+#ifdef TASK_VIRTUAL_TIME
+  virtualTime = 0;
+#endif
+#ifdef TASK_PROFILING
+  resetProfile();
+#endif
+}
+
+// add slot to the end of circular list
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::append(Index *head, Index slot, byte list) {
+  TaskLinks<Index> *link = links + slot;
+  link->list = list;
+  if (*head == NO_TASK) {
+    link->prev = slot;
+    link->next = slot;
+    *head = slot;
+  } else {
+    Index last = links[*head].prev;
+    link->prev = last;
+    link->next = *head;
+    links[last].next = slot;
+    links[*head].prev = slot;
+  }
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::unlink(Index *head, Index slot) {
+  TaskLinks<Index> *link = links + slot;
+  if (link->next == slot) {
+    *head = NO_TASK;
+  } else {
+    links[link->prev].next = link->next;
+    links[link->next].prev = link->prev;
+    if (*head == slot) *head = link->next;
+  }
+}
+
+// head of list with given TaskLinks::list value
+TASK_MANAGER_TEMPLATE
+typename TASK_MANAGER::Index* TASK_MANAGER::head(byte list) {
+  if (list>=LIST_BUCKET) return buckets[0]+(list-LIST_BUCKET);
+  if (list>=LIST_MIXED) return mixed+(list-LIST_MIXED);
+  return ready+(list-LIST_READY);
+}
+
+// wraparound safe time order of two slots
+TASK_MANAGER_TEMPLATE
+boolean TASK_MANAGER::before(Index a, Index b) {
+  return (TaskSpan)(links[a].due - links[b].due) < 0;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::siftUp(Index pos) {
+  Index slot = timers[pos];
+  while (pos>0) {
+    Index parent = (pos-1)/2;
+    if (!before(slot, timers[parent])) break;
+    timers[pos] = timers[parent];
+    links[timers[pos]].heap = pos;
+    pos = parent;
+  }
+  timers[pos] = slot;
+  links[slot].heap = pos;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::siftDown(Index pos) {
+  Index slot = timers[pos];
+  for(;;) {
+    unsigned int child = 2*(unsigned int)pos+1;
+    if (child>=timerCount) break;
+    if (child+1<timerCount && before(timers[child+1], timers[child])) child++;
+    if (!before(timers[child], slot)) break;
+    timers[pos] = timers[child];
+    links[timers[pos]].heap = pos;
+    pos = child;
+  }
+  timers[pos] = slot;
+  links[slot].heap = pos;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::pushTimer(Index slot) {
+  links[slot].list = LIST_TIMERS;
+  links[slot].due = queue[slot].time + queue[slot].slack;
+  timers[timerCount] = slot;
+  siftUp(timerCount++);
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::removeTimer(Index pos) {
+  Index last = timers[--timerCount];
+  if (pos<timerCount) {
+    timers[pos] = last;
+    siftDown(pos);
+    siftUp(links[last].heap);
+  }
+}
+
+// put active task into structure matching its trigger
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::file(Index slot) {
+  MaskT trigger = queue[slot].trigger;
+  byte priority = queue[slot].priority;
+  if (trigger & TIME_TRIGGER) {
+    pushTimer(slot);
+  } else if (trigger & (trigger-1)) {
+    append(mixed+priority, slot, LIST_MIXED+priority);
+  } else {
+    byte bit = 0;
+    while (trigger>>=1) bit++;
+    append(buckets[priority]+bit, slot, LIST_BUCKET+priority*TRIGGER_BITS+bit);
+  }
+}
+
+// take slot out of whatever structure holds it
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::detach(Index slot) {
+  byte list = links[slot].list;
+  switch (list) {
+    case LIST_TIMERS:
+      removeTimer(links[slot].heap);
+      break;
+    case LIST_DEFERRED:
+      unlink(&deferred, slot);
+      break;
+    default:
+      if (list>=LIST_READY) unlink(head(list), slot);
+  }
+  links[slot].list = LIST_FREE;
+}
+
+// return detached slot to free list
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::release(Index slot) {
+  unindexId(slot);
+  queue[slot].clear();
+  append(&freeSlots, slot, LIST_FREE);
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::indexId(Index slot) {
+  byte id = queue[slot].id;
+  Index *head = ids + (id & (ID_BUCKETS-1));
+  links[slot].id = id;
+  links[slot].idNext = *head;
+  *head = slot;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::unindexId(Index slot) {
+  Index *head = ids + (links[slot].id & (ID_BUCKETS-1));
+  while (*head!=slot) head = &links[*head].idNext;
+  *head = links[slot].idNext;
+}
+
+TASK_MANAGER_TEMPLATE
+typename TASK_MANAGER::TaskType* TASK_MANAGER::addTaskInternal(byte id, MaskT trigger, TaskTime firstInvocation, HandlerType *handler) {
+  if (!id || freeSlots==NO_TASK || findTask(id)) return NULL;
+  Index slot = freeSlots;
+  unlink(&freeSlots, slot);
+  TaskType *task = queue + slot;
+  task->id = id;
+  task->trigger = trigger;
+  task->setHandler(handler);
+  task->time = firstInvocation;
+  task->priority = PRIORITY_NORMAL<TASK_PRIORITIES ? PRIORITY_NORMAL : PRIORITY_LOW;
+  task->overrun = OVERRUN_CATCH_UP;
+  task->slack = 0;
+  indexId(slot);
+  if (inLoop) {
+    // tasks added by handlers wait for next loop
+    append(&deferred, slot, LIST_DEFERRED);
+  } else {
+    file(slot);
+  }
+  return task;
+}
+
+TASK_MANAGER_TEMPLATE
+typename TASK_MANAGER::TaskType* TASK_MANAGER::addTask(byte id, MaskT trigger, TaskTime invocationDelay, HandlerType *handler) {
+  return addTaskInternal(id, trigger | TIME_TRIGGER, now()+invocationDelay, handler);
+}
+
+TASK_MANAGER_TEMPLATE
+typename TASK_MANAGER::TaskType* TASK_MANAGER::addTask(byte id, MaskT trigger, HandlerType *handler) {
+  return addTaskInternal(id, trigger, 0, handler);
+}
+
+TASK_MANAGER_TEMPLATE
+typename TASK_MANAGER::TaskType* TASK_MANAGER::addTask(byte id, MaskT trigger, TaskTime invocationDelay, FunctionType function, void *context) {
+  TaskType *task = addTask(id, trigger, invocationDelay, (HandlerType*)NULL);
+  if (task) task->setFunction(function, context);
+  return task;
+}
+
+TASK_MANAGER_TEMPLATE
+typename TASK_MANAGER::TaskType* TASK_MANAGER::addTask(byte id, MaskT trigger, FunctionType function, void *context) {
+  TaskType *task = addTask(id, trigger, (HandlerType*)NULL);
+  if (task) task->setFunction(function, context);
+  return task;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::removeTask(byte id) {
+  TaskType *task = findTask(id);
+  if (!task) return;
+  Index slot = task - queue;
+  if (links[slot].list==LIST_RUNNING) {
+    // running task is released by loop once its handler returns
+    task->clear();
+  } else {
+    detach(slot);
+    release(slot);
+  }
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::setPriority(TaskType *task, byte priority) {
+  if (priority>=TASK_PRIORITIES) priority = PRIORITY_LOW;
+  task->priority = priority;
+  updateTask(task);
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::setSlack(TaskType *task, unsigned short slack) {
+  task->slack = slack;
+  updateTask(task);
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::onOverrun(void (*callback)(TaskType *task, TaskTime late)) {
+  overrunCallback = callback;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::addOverruns(unsigned short missed) {
+  overruns += missed;
+}
+
+TASK_MANAGER_TEMPLATE
+unsigned long TASK_MANAGER::overrunCount() {
+  return overruns;
+}
+
+TASK_MANAGER_TEMPLATE
+typename TASK_MANAGER::TaskType* TASK_MANAGER::findTask(byte id) {
+  Index slot = ids[id & (ID_BUCKETS-1)];
+  for(;slot!=NO_TASK;slot=links[slot].idNext) {
+    if (queue[slot].id==id && queue[slot].trigger) return queue+slot;
+  }
+  return NULL;
+}
+
+TASK_MANAGER_TEMPLATE
+typename TASK_MANAGER::TaskType* TASK_MANAGER::runningTask() {
+  return running;
+}
+
+TASK_MANAGER_TEMPLATE
+typename TASK_MANAGER::TaskType* TASK_MANAGER::nextTask(TaskType *task) {
+  unsigned int slot = task ? task-queue+1 : 0;
+  for(;slot<Tasks;slot++) {
+    if (queue[slot].trigger) return queue+slot;
+  }
+  return NULL;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::updateTask(TaskType *task) {
+  Index slot = task - queue;
+  byte list = links[slot].list;
+  // running and deferred tasks are filed when loop ends
+  if (list==LIST_FREE || list==LIST_RUNNING || list==LIST_DEFERRED) return;
+  detach(slot);
+  if (task->trigger) {
+    file(slot);
+  } else {
+    release(slot);
+  }
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::writeDebugReportSync() {
+  Serial.println("Queue report:");
+  Serial.print("Time : ");
+  Serial.println(now());
+  unsigned int i;
+  for(i=0;i<Tasks;i++) {
+    Serial.print(i);
+    Serial.print(" : ");
+    if (queue[i].trigger) {
+      Serial.print(queue[i].id);
+      Serial.print(",");
+      Serial.print(queue[i].trigger, HEX);
+      Serial.print(",");
+      Serial.println(queue[i].time);
+    } else {
+      Serial.println("----");
+    }
+  }
+  Serial.println("Triggers ");
+  for(i=0;i<Triggers && triggers[i];i++) {
+    Serial.print(triggers[i]->trigger(), HEX);
+    Serial.print(':');
+    Serial.println(triggers[i]->isOn());
+  }
+}
+
+#ifdef TASK_PROFILING
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::profile(byte id, boolean timed, TaskTime late, unsigned long runTime) {
+  TaskProfile *entry = NULL;
+  unsigned int i;
+  for(i=0;i<PROFILE_SIZE;i++) {
+    if (profiles[i].id==id) {
+      entry = profiles+i;
+      break;
+    }
+    if (!profiles[i].id && !entry) entry = profiles+i;
+  }
+  if (!entry) {
+    unprofiledCalls++;
+    return;
+  }
+  entry->id = id;
+  entry->calls++;
+  entry->totalTime += runTime;
+  if (runTime>entry->maxTime) entry->maxTime = runTime;
+  if (timed) {
+    byte bucket = 0;
+    while (late && bucket<PROFILE_LATE_BUCKETS-1) {
+      late >>= 1;
+      bucket++;
+    }
+    if (entry->late[bucket]!=0xFFFF) entry->late[bucket]++;
+  }
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::writeProfileReportSync() {
+  unsigned int i, j;
+  byte count = 0;
+  for(i=0;i<PROFILE_SIZE;i++) {
+    if (profiles[i].id) count++;
+  }
+  Serial.write(PROFILE_REPORT_TAG);
+  Serial.write(PROFILE_REPORT_VERSION);
+  Serial.write(count);
+  Serial.write(PROFILE_LATE_BUCKETS);
+  taskWriteLong(unprofiledCalls);
+  for(i=0;i<PROFILE_SIZE;i++) {
+    TaskProfile *entry = profiles+i;
+    if (!entry->id) continue;
+    Serial.write(entry->id);
+    taskWriteLong(entry->calls);
+    taskWriteLong(entry->totalTime);
+    taskWriteLong(entry->maxTime);
+    for(j=0;j<PROFILE_LATE_BUCKETS;j++) {
+      Serial.write((byte)entry->late[j]);
+      Serial.write((byte)(entry->late[j]>>8));
+    }
+  }
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::resetProfile() {
+  memset(profiles, 0, sizeof(profiles));
+  unprofiledCalls = 0;
+}
+#endif
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::registerTrigger(TriggerType *trigger) {
+  unsigned int i;
+  for(i=0;i<Triggers;i++) {
+    if (!triggers[i]) {
+      triggers[i] = trigger;
+      return;
+    }
+  }
+}
+
+TASK_MANAGER_TEMPLATE
+boolean TASK_MANAGER::post(byte id, MaskT trigger) {
+  byte head = eventHead;
+  byte next = (head+1) & (TASK_EVENT_QUEUE_SIZE-1);
+  if (next==eventTail) return false;
+  posted[head].id = id;
+  posted[head].trigger = trigger;
+  // record must be complete before loop can see it
+  TASK_EVENT_BARRIER();
+  eventHead = next;
+  return true;
+}
+
+TASK_MANAGER_TEMPLATE
+boolean TASK_MANAGER::postEvent(MaskT trigger) {
+  return post(0, trigger);
+}
+
+TASK_MANAGER_TEMPLATE
+boolean TASK_MANAGER::postTask(byte id) {
+  return id && post(id, 0);
+}
+
+// take posted events, activated tasks go to front of their ready list.
+// returns posted trigger bits
+TASK_MANAGER_TEMPLATE
+MaskT TASK_MANAGER::drainEvents() {
+  MaskT trigger = 0;
+  byte tail = eventTail;
+  while (tail!=eventHead) {
+    TASK_EVENT_BARRIER();
+    TaskEvent<MaskT> *event = posted + tail;
+    if (event->id) {
+      TaskType *task = findTask(event->id);
+      if (task) {
+        Index slot = task - queue;
+        detach(slot);
+        append(ready+task->priority, slot, LIST_READY+task->priority);
+      }
+    } else {
+      trigger |= event->trigger;
+    }
+    tail = (tail+1) & (TASK_EVENT_QUEUE_SIZE-1);
+    // slot is free for producer only after record was read
+    TASK_EVENT_BARRIER();
+    eventTail = tail;
+  }
+  return trigger;
+}
+
+TASK_MANAGER_TEMPLATE
+MaskT TASK_MANAGER::getEvents() {
+  MaskT trigger = TIME_TRIGGER;
+  unsigned int i;
+  for(i=0;i<Triggers && triggers[i];i++) {
+    trigger = triggers[i]->setTrigger(trigger);
+  }
+  return trigger;
+}
+
+TASK_MANAGER_TEMPLATE
+MaskT TASK_MANAGER::updateEvents(MaskT trigger) {
+  unsigned int i;
+  for(i=0;i<Triggers && triggers[i];i++) {
+    trigger = triggers[i]->refresh(trigger);
+  }
+  return trigger;
+}
+    
+#ifdef TASK_TRACE
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::traceEvents(MaskT events) {
+  if (events==tracedEvents) return;
+  tracedEvents = events;
+  taskTrace(TRACE_TRIGGERS, events);
+}
+#endif
+
+TASK_MANAGER_TEMPLATE
+MaskT TASK_MANAGER::dispatch(Index slot, MaskT trigger, TaskTime time) {
+  TaskType *current = queue + slot;
+  links[slot].list = LIST_RUNNING;
+#if defined(TASK_PROFILING) || defined(TASK_TRACE)
+  byte id = current->id;
+#endif
+#ifdef TASK_TRACE
+  boolean quiet = id==taskTraceIgnored();
+  if (quiet) taskTracePause(true);
+  taskTrace(TRACE_TASK_START, id);
+#endif
+#ifdef TASK_PROFILING
+  boolean timed = current->trigger & TIME_TRIGGER;
+  TaskTime late = time - current->time;
+  unsigned long start = micros();
+#endif
+  running = current;
+  if (current->function) {
+    current->function(current, trigger, time);
+  } else {
+    current->handler->doTask(current, trigger, time);
+  }
+  running = NULL;
+#ifdef TASK_PROFILING
+  profile(id, timed, late, micros() - start);
+#endif
+#ifdef TASK_TRACE
+  taskTrace(TRACE_TASK_END, id);
+#endif
+  if (current->trigger) {
+    if (current->id!=links[slot].id) {
+      unindexId(slot);
+      indexId(slot);
+    }
+    // handler could have changed trigger or time, so task is filed again
+    // when loop ends. this also limits task to one run per loop
+    append(&deferred, slot, LIST_DEFERRED);
+  } else {
+    release(slot);
+  }
+  trigger = updateEvents(trigger);
+#ifdef TASK_TRACE
+  // mask is taken as traced, so changes of ignored task are not recorded later
+  traceEvents(trigger);
+  if (quiet) taskTracePause(false);
+#endif
+  return trigger;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::loop() {
+  // form trigger bits
+  TaskTime time = now();
+  MaskT trigger = drainEvents();
+  trigger |= getEvents();
+#ifdef TASK_TRACE
+  traceEvents(trigger);
+#endif
+  Index slot;
+  inLoop = true;
+  // move due timers to ready list of their class. heap hands them out
+  // earliest first, so each ready list is in deadline order
+  boolean woken = false;
+  while (timerCount) {
+    slot = timers[0];
+    TaskSpan timeframe = time - links[slot].due;
+    if (timeframe<0) break;
+    removeTimer(0);
+    woken = true;
+    if (timeframe>=LATE_TIME_THRESHOLD) {
+      overruns++;
+      if (queue[slot].overrun==OVERRUN_FAIL) {
+        // cleared trigger hides task from findTask, so callback could add it again
+        links[slot].list = LIST_FREE;
+        queue[slot].trigger = 0;
+        if (overrunCallback) overrunCallback(queue+slot, timeframe);
+        release(slot);
+        continue;
+      }
+    }
+    byte priority = queue[slot].priority;
+    append(ready+priority, slot, LIST_READY+priority);
+  }
+  // timers whose slack window is open join this wakeup instead of taking
+  // one of their own. heap is walked from its end, so slot removal only
+  // moves unseen timers into current position
+  Index pos = woken ? timerCount : 0;
+  while (pos>0) {
+    slot = timers[pos-1];
+    if ((TaskSpan)(time - queue[slot].time)<0) {
+      pos--;
+      continue;
+    }
+    removeTimer(pos-1);
+    if (pos>timerCount) pos = timerCount;
+    byte priority = queue[slot].priority;
+    append(ready+priority, slot, LIST_READY+priority);
+  }
+  byte priority, bit, n;
+  unsigned long start = budget ? micros() : 0;
+  // set once budget is spent, tasks not dispatched yet stay where they are
+  boolean over = false;
+  for(n=0;n<TASK_PRIORITIES && !over;n++) {
+    priority = resumePriority+n;
+    if (priority>=TASK_PRIORITIES) priority -= TASK_PRIORITIES;
+    if (overloaded && priority>=shedPriority) {
+      load.shed += runnable(priority, trigger);
+      continue;
+    }
+    // due timers first
+    Index *list = ready+priority;
+    while (*list!=NO_TASK && !over) {
+      slot = *list;
+      unlink(list, slot);
+      trigger = dispatch(slot, trigger, time);
+      over = budget && micros()-start>=budget;
+    }
+    // then tasks waiting for raised triggers. bucket is revisited while
+    // its bit stays on as handlers could release or take resources
+    for(bit=1;bit<TRIGGER_BITS;bit++) {
+      list = buckets[priority]+bit;
+      while ((trigger & ((MaskT)1<<bit)) && *list!=NO_TASK && !over) {
+        slot = *list;
+        unlink(list, slot);
+        trigger = dispatch(slot, trigger, time);
+        over = budget && micros()-start>=budget;
+      }
+    }
+    list = mixed+priority;
+    while (*list!=NO_TASK && !over) {
+      slot = *list;
+      unlink(list, slot);
+      if (queue[slot].matches(trigger, time)) {
+        trigger = dispatch(slot, trigger, time);
+        over = budget && micros()-start>=budget;
+      } else {
+        append(&deferred, slot, LIST_DEFERRED);
+      }
+    }
+  }
+  byte first = resumePriority;
+  resumePriority = 0;
+  if (over) {
+    load.overloads++;
+    // class budget ran out in could still have runnable tasks
+    load.deferred += runnable(priority, trigger);
+    if (priority+1<shedPriority && priority+1<TASK_PRIORITIES) resumePriority = priority+1;
+    // classes not reached are shed or wait for next loop
+    for(;n<TASK_PRIORITIES;n++) {
+      priority = first+n;
+      if (priority>=TASK_PRIORITIES) priority -= TASK_PRIORITIES;
+      if (priority>=shedPriority) {
+        load.shed += runnable(priority, trigger);
+      } else {
+        load.deferred += runnable(priority, trigger);
+      }
+    }
+  }
+  overloaded = over;
+  // file everything touched for next loop
+  while (deferred!=NO_TASK) {
+    slot = deferred;
+    unlink(&deferred, slot);
+    file(slot);
+  }
+  inLoop = false;
+}
+
+TASK_MANAGER_TEMPLATE
+TaskTime TASK_MANAGER::now() {
+#ifdef TASK_VIRTUAL_TIME
+  return virtualTime;
+#else
+  return TASK_CLOCK();
+#endif
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::setBudget(unsigned long micros) {
+  budget = micros;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::setShedPriority(byte priority) {
+  shedPriority = priority;
+}
+
+TASK_MANAGER_TEMPLATE
+TaskLoadStats TASK_MANAGER::loadStats() {
+  return load;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::resetLoadStats() {
+  memset(&load, 0, sizeof(load));
+}
+
+// slots in circular list
+TASK_MANAGER_TEMPLATE
+unsigned int TASK_MANAGER::length(Index head) {
+  unsigned int count = 0;
+  Index slot = head;
+  if (slot==NO_TASK) return 0;
+  do {
+    count++;
+    slot = links[slot].next;
+  } while (slot!=head);
+  return count;
+}
+
+// tasks of class that would run with trigger
+TASK_MANAGER_TEMPLATE
+unsigned int TASK_MANAGER::runnable(byte priority, MaskT trigger) {
+  unsigned int count = length(ready[priority]);
+  byte bit;
+  for(bit=1;bit<TRIGGER_BITS;bit++) {
+    if (trigger & ((MaskT)1<<bit)) count += length(buckets[priority][bit]);
+  }
+  Index slot = mixed[priority];
+  if (slot==NO_TASK) return count;
+  do {
+    if (queue[slot].matches(trigger, 0)) count++;
+    slot = links[slot].next;
+  } while (slot!=mixed[priority]);
+  return count;
+}
+
+TASK_MANAGER_TEMPLATE
+boolean TASK_MANAGER::nextWakeup(TaskTime *time) {
+  byte priority;
+  for(priority=0;priority<TASK_PRIORITIES;priority++) {
+    // due tasks left by loop that ran out of budget
+    if (ready[priority]!=NO_TASK) {
+      *time = now();
+      return true;
+    }
+  }
+  if (!timerCount) return false;
+  *time = links[timers[0]].due;
+  return true;
+}
+
+// triggers parked tasks are waiting for
+TASK_MANAGER_TEMPLATE
+MaskT TASK_MANAGER::waitingEvents() {
+  MaskT events = 0;
+  byte priority, bit;
+  for(priority=0;priority<TASK_PRIORITIES;priority++) {
+    for(bit=1;bit<TRIGGER_BITS;bit++) {
+      if (buckets[priority][bit]!=NO_TASK) events |= (MaskT)1<<bit;
+    }
+    Index slot = mixed[priority];
+    if (slot==NO_TASK) continue;
+    do {
+      events |= queue[slot].trigger;
+      slot = links[slot].next;
+    } while (slot!=mixed[priority]);
+  }
+  return events;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::idleLoop() {
+  loop();
+  TaskTime wakeup = 0;
+  boolean timed = nextWakeup(&wakeup);
+  MaskT events = waitingEvents();
+  // nothing queued, sleeping would only block the sketch
+  if (!timed && !events) return;
+#ifdef TASK_VIRTUAL_TIME
+  if (timed) skipIdle(wakeup);
+#else
+  while (!(getEvents() & events) && eventHead==eventTail) {
+    // triggers are only polled, so check them at least every ms
+    TaskTime timeout = TASK_MS(1);
+    if (timed) {
+      TaskSpan remaining = wakeup - now();
+      if (remaining<=0) return;
+      if (!events) timeout = remaining;
+    }
+    taskSleep(timeout);
+  }
+#endif
+}
+
+#ifdef TASK_VIRTUAL_TIME
+// jump clock to next due task or limit, whichever is first, if nothing
+// could run before. false if clock stays
+TASK_MANAGER_TEMPLATE
+boolean TASK_MANAGER::skipIdle(TaskTime limit) {
+  if (eventHead!=eventTail || (getEvents() & waitingEvents())) return false;
+  TaskTime wakeup;
+  if (!nextWakeup(&wakeup) || (TaskSpan)(wakeup - limit)>0) wakeup = limit;
+  if ((TaskSpan)(wakeup - virtualTime)<=0) return false;
+  virtualTime = wakeup;
+  return true;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::setTime(TaskTime time) {
+  virtualTime = time;
+}
+
+TASK_MANAGER_TEMPLATE
+void TASK_MANAGER::runUntil(TaskTime time) {
+  for(;;) {
+    loop();
+    if ((TaskSpan)(time - virtualTime)<=0) break;
+    skipIdle(time);
+  }
+}
+#endif
+
+#endif
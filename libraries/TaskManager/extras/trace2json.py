@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# converts serial dump of TASK_TRACE records to chrome trace json, open
+# result in chrome://tracing or ui.perfetto.dev
+#
+#   trace2json.py capture.bin > trace.json
+#
+# other serial output between trace chunks is skipped
+
+import json
+import struct
+import sys
+
+TAG = ord('T')
+VERSION = 1
+
+TASK_START, TASK_END, TRIGGERS, AQUIRE, RELEASE, TWI_START, TWI_DONE = range(1, 8)
+
+# one row per source in trace viewer
+TID_TASKS, TID_RESOURCES, TID_TWI = 1, 2, 3
+
+
+def records(data):
+    pos = 0
+    while pos+4 <= len(data):
+        if data[pos] != TAG or data[pos+1] != VERSION:
+            pos += 1
+            continue
+        count, dropped = data[pos+2], data[pos+3]
+        end = pos+4+count*6
+        if end > len(data):
+            break
+        if dropped:
+            yield None, dropped, None
+        for i in range(pos+4, end, 6):
+            kind, value, time = struct.unpack_from('<BBI', data, i)
+            yield kind, value, time
+        pos = end
+
+
+def convert(data):
+    events = []
+    last = None
+    base = 0
+    for kind, value, time in records(data):
+        if kind is None:
+            events.append({'name': 'dropped %d' % value, 'ph': 'i', 's': 'g',
+                           'pid': 1, 'tid': TID_TASKS, 'ts': last or 0})
+            continue
+        # clock is 32 bit, unwrap assuming records are in order
+        if last is not None and time+base < last:
+            base += 1 << 32
+        ts = time+base
+        last = ts
+        event = {'pid': 1, 'ts': ts}
+        if kind in (TASK_START, TASK_END):
+            event.update(name='task %d' % value, tid=TID_TASKS,
+                         ph='B' if kind == TASK_START else 'E')
+        elif kind in (AQUIRE, RELEASE):
+            # holds of different resources overlap, so they are async spans
+            event.update(name='resource 0x%02x' % value, tid=TID_RESOURCES,
+                         cat='resource', id=value,
+                         ph='b' if kind == AQUIRE else 'e')
+        elif kind in (TWI_START, TWI_DONE):
+            event.update(name='twi 0x%02x' % value, tid=TID_TWI,
+                         cat='twi', id=value,
+                         ph='b' if kind == TWI_START else 'e')
+        elif kind == TRIGGERS:
+            event.update(name='triggers', ph='C', args={'mask': value})
+        else:
+            continue
+        events.append(event)
+    return {'traceEvents': events, 'displayTimeUnit': 'ms'}
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('usage: trace2json.py capture.bin')
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+    json.dump(convert(data), sys.stdout, indent=1)
+
+
+if __name__ == '__main__':
+    main()
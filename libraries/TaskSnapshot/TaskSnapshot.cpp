@@ -0,0 +1,270 @@
+#include <TaskSnapshot.h>
+
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#endif
+
+#define NO_HANDLER (0xFF)
+
+void TaskSnapshot::init() {
+  memset(handlers, 0, sizeof(handlers));
+  memset(resources, 0, sizeof(resources));
+}
+
+boolean TaskSnapshot::registerHandler(byte number, Task::Function function, void *context,
+                                      SnapshotHook hook) {
+  if (number>=MAX_SNAPSHOT_HANDLERS) return false;
+  handlers[number].function = function;
+  handlers[number].context = context;
+  handlers[number].hook = hook;
+  return true;
+}
+
+boolean TaskSnapshot::registerHandler(byte number, TaskHandler *handler, SnapshotHook hook) {
+  return registerHandler(number, NULL, handler, hook);
+}
+
+boolean TaskSnapshot::registerResource(ResourceTrigger *resource) {
+  byte i;
+  for(i=0;i<MAX_SNAPSHOT_RESOURCES;i++) {
+    if (!resources[i]) {
+      resources[i] = resource;
+      return true;
+    }
+  }
+  return false;
+}
+
+byte TaskSnapshot::handlerOf(Task *task) {
+  byte i;
+  for(i=0;i<MAX_SNAPSHOT_HANDLERS;i++) {
+    HandlerEntry *entry = handlers+i;
+    if (!entry->function && !entry->context) continue;
+    if (entry->function!=task->function) continue;
+    // handler shares storage with context
+    if (entry->context==task->context) return i;
+  }
+  return NO_HANDLER;
+}
+
+byte TaskSnapshot::savedHandlerOf(Task *task) {
+  byte handler = handlerOf(task);
+  if (handler==NO_HANDLER) return NO_HANDLER;
+  SnapshotHook hook = handlers[handler].hook;
+  if (hook && !hook(task, false)) return NO_HANDLER;
+  return handler;
+}
+
+boolean TaskSnapshot::open(boolean write) {
+  pos = 0;
+  sum1 = 0;
+  sum2 = 0;
+#if defined(__AVR__)
+  return true;
+#elif !defined(ARDUINO)
+  file = fopen(TASK_SNAPSHOT_FILE, write ? "r+b" : "rb");
+  // first save creates file
+  if (!file && write) file = fopen(TASK_SNAPSHOT_FILE, "wb");
+  return file!=NULL;
+#else
+  // no storage on this board
+  return false;
+#endif
+}
+
+void TaskSnapshot::close() {
+#if !defined(__AVR__) && !defined(ARDUINO)
+  fclose(file);
+#endif
+}
+
+void TaskSnapshot::put(byte value) {
+#if defined(__AVR__)
+  // update skips unchanged cells, saves eeprom wear
+  eeprom_update_byte((uint8_t*)(TASK_SNAPSHOT_ADDRESS+pos), value);
+#elif !defined(ARDUINO)
+  fputc(value, file);
+#endif
+  pos++;
+  // mod 255, sums stay below 2*255 so subtraction is enough
+  sum1 += value;
+  if (sum1>=255) sum1 -= 255;
+  sum2 += sum1;
+  if (sum2>=255) sum2 -= 255;
+}
+
+byte TaskSnapshot::get() {
+  byte value = 0;
+#if defined(__AVR__)
+  value = eeprom_read_byte((const uint8_t*)(TASK_SNAPSHOT_ADDRESS+pos));
+#elif !defined(ARDUINO)
+  int read = fgetc(file);
+  if (read!=EOF) value = read;
+#endif
+  pos++;
+  // mod 255, sums stay below 2*255 so subtraction is enough
+  sum1 += value;
+  if (sum1>=255) sum1 -= 255;
+  sum2 += sum1;
+  if (sum2>=255) sum2 -= 255;
+  return value;
+}
+
+void TaskSnapshot::putLong(unsigned long value) {
+  byte i;
+  for(i=0;i<4;i++) {
+    put((byte)value);
+    value >>= 8;
+  }
+}
+
+unsigned long TaskSnapshot::getLong() {
+  unsigned long value = 0;
+  byte i;
+  for(i=0;i<4;i++) {
+    value |= (unsigned long)get() << (8*i);
+  }
+  return value;
+}
+
+byte TaskSnapshot::save() {
+  Task *task;
+  byte count = 0;
+  for(task=TM.nextTask(NULL);task;task=TM.nextTask(task)) {
+    if (savedHandlerOf(task)!=NO_HANDLER) count++;
+  }
+  if (!open(true)) return 0;
+  TaskTime now = TM.now();
+  put(SNAPSHOT_TAG);
+  put(SNAPSHOT_VERSION);
+  put(TASK_STATE_SIZE);
+  put(TASK_POOL_ENTRY_SIZE);
+  put(count);
+  put(MAX_SNAPSHOT_RESOURCES);
+  byte i;
+  for(i=0;i<MAX_SNAPSHOT_RESOURCES;i++) {
+    byte holder = resources[i] ? resources[i]->holder() : 0;
+    task = holder ? TM.findTask(holder) : NULL;
+    // holder that isn't saved would never release it
+    put(task && savedHandlerOf(task)!=NO_HANDLER ? holder : 0);
+  }
+  for(task=TM.nextTask(NULL);task;task=TM.nextTask(task)) {
+    byte handler = savedHandlerOf(task);
+    if (handler==NO_HANDLER) continue;
+    put(handler);
+    put(task->id);
+    put(task->trigger);
+    // times are relative, clock starts over after reset
+    putLong(task->time - now);
+    put(task->priority);
+    put(task->overrun);
+    put((byte)task->slack);
+    put(task->slack>>8);
+    for(i=0;i<TASK_STATE_SIZE;i++) {
+      put(task->storage.data[i]);
+    }
+    byte *entry = (byte*)TaskStates.of(task);
+    put(entry!=NULL);
+    if (!entry) continue;
+    for(i=0;i<TASK_POOL_ENTRY_SIZE;i++) {
+      put(entry[i]);
+    }
+  }
+  byte check1 = sum1;
+  byte check2 = sum2;
+  put(check1);
+  put(check2);
+  close();
+  return count;
+}
+
+boolean TaskSnapshot::read(boolean apply) {
+  if (!open(false)) return false;
+  boolean valid = get()==SNAPSHOT_TAG && get()==SNAPSHOT_VERSION && get()==TASK_STATE_SIZE
+      && get()==TASK_POOL_ENTRY_SIZE;
+  if (!valid) {
+    close();
+    return false;
+  }
+  byte count = get();
+  byte resourceCount = get();
+  byte i, j;
+  byte holders[MAX_SNAPSHOT_RESOURCES];
+  for(i=0;i<resourceCount;i++) {
+    byte holder = get();
+    if (i<MAX_SNAPSHOT_RESOURCES) holders[i] = holder;
+  }
+  for(;i<MAX_SNAPSHOT_RESOURCES;i++) {
+    holders[i] = 0;
+  }
+  TaskTime now = TM.now();
+  for(i=0;i<count;i++) {
+    byte handler = get();
+    byte id = get();
+    byte trigger = get();
+    TaskTime time = now + getLong();
+    byte priority = get();
+    byte overrun = get();
+    unsigned short slack = get();
+    slack |= get()<<8;
+    Task *task = NULL;
+    HandlerEntry *entry = handlers+handler;
+    if (apply && handler<MAX_SNAPSHOT_HANDLERS) {
+      if (entry->function) {
+        task = TM.addTask(id, trigger, entry->function, entry->context);
+      } else if (entry->context) {
+        task = TM.addTask(id, trigger, (TaskHandler*)entry->context);
+      }
+    }
+    for(j=0;j<TASK_STATE_SIZE;j++) {
+      byte value = get();
+      if (task) task->storage.data[j] = value;
+    }
+    byte *state = NULL;
+    if (get()) {
+      // new entry of same content, its number is set in task state
+      if (task) state = (byte*)TaskStates.take(task, task->function, task->context);
+      for(j=0;j<TASK_POOL_ENTRY_SIZE;j++) {
+        byte value = get();
+        if (state) state[j] = value;
+      }
+      if (task && !state) {
+        TM.removeTask(id);
+        task = NULL;
+      }
+    }
+    if (task) {
+      task->time = time;
+      task->overrun = overrun;
+      task->slack = slack;
+      // refiles task for its restored time
+      TM.setPriority(task, priority);
+      if (entry->hook && !entry->hook(task, true)) {
+        TM.removeTask(id);
+        continue;
+      }
+      for(j=0;j<MAX_SNAPSHOT_RESOURCES;j++) {
+        if (resources[j] && holders[j]==id) resources[j]->aquire(id);
+      }
+    }
+  }
+  byte check1 = sum1;
+  byte check2 = sum2;
+  valid = get()==check1 && get()==check2;
+  close();
+  return valid;
+}
+
+boolean TaskSnapshot::restore() {
+  // check whole snapshot before anything is added
+  if (!read(false)) return false;
+  return read(true);
+}
+
+void TaskSnapshot::erase() {
+  if (!open(true)) return;
+  put(0);
+  close();
+}
+
+TaskSnapshot Snapshot = TaskSnapshot();
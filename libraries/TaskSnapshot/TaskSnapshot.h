@@ -0,0 +1,104 @@
+#ifndef TASK_SNAPSHOT_INCLUDED
+#define TASK_SNAPSHOT_INCLUDED
+
+#include <Arduino.h>
+#include <TaskManager.h>
+#include <Triggers.h>
+#if !defined(__AVR__) && !defined(ARDUINO)
+#include <stdio.h>
+#endif
+
+// where snapshot is kept: eeprom offset on avr, file on host
+#ifndef TASK_SNAPSHOT_ADDRESS
+#define TASK_SNAPSHOT_ADDRESS (0)
+#endif
+#ifndef TASK_SNAPSHOT_FILE
+#define TASK_SNAPSHOT_FILE    "tasks.snapshot"
+#endif
+
+// handlers and resources that could be saved
+#ifndef MAX_SNAPSHOT_HANDLERS
+#define MAX_SNAPSHOT_HANDLERS (8)
+#endif
+#ifndef MAX_SNAPSHOT_RESOURCES
+#define MAX_SNAPSHOT_RESOURCES (4)
+#endif
+
+#define SNAPSHOT_TAG          ('S')
+#define SNAPSHOT_VERSION      (4)
+
+// called for each task of handler before it is saved, restored false, and
+// after it is added again, restored true. false skips or removes task
+typedef boolean (*SnapshotHook)(Task *task, boolean restored);
+
+// saves queued tasks of TM with their state, so sketch could continue after
+// watchdog reset or brown out. handlers are saved by number given at
+// registration, state and TaskStates entry of task as raw bytes. restored
+// task takes a new entry. pointers in state, e.g. curves, channels or
+// buffers of sketch, stay good only for same build, so snapshot is too.
+// hook of handler refuses tasks or fixes them up on restore, e.g. places in
+// line of a semaphore. tasks of unregistered handlers are skipped. held
+// resource is held again only if task holding it is restored, so it is
+// released as that task goes on
+//
+// layout: tag, version, state size, entry size, task count, resource count
+// per resource: holder id, 0 if free
+// per task: handler, id, trigger, time left (4, signed), priority, overrun,
+// slack (2), state, entry flag, entry if flag is set
+// fletcher-16 of everything before (2)
+class TaskSnapshot {
+  struct HandlerEntry {
+    Task::Function function;
+    void *context;
+    SnapshotHook hook;
+  };
+
+  HandlerEntry handlers[MAX_SNAPSHOT_HANDLERS];
+  ResourceTrigger *resources[MAX_SNAPSHOT_RESOURCES];
+
+  // storage cursor and running checksum
+  unsigned int pos;
+  unsigned short sum1;
+  unsigned short sum2;
+#if !defined(__AVR__) && !defined(ARDUINO)
+  FILE *file;
+#endif
+
+  boolean open(boolean write);
+  void close();
+  void put(byte value);
+  byte get();
+  void putLong(unsigned long value);
+  unsigned long getLong();
+  // handler number of task or 0xFF
+  byte handlerOf(Task *task);
+  // same, 0xFF also if hook of handler refuses task
+  byte savedHandlerOf(Task *task);
+  // walk stored snapshot, adding tasks if apply is set. false if it is invalid
+  boolean read(boolean apply);
+
+  public:
+    void init();
+    // number identifies handler in snapshot, use same number after reset
+    boolean registerHandler(byte number, Task::Function function, void *context,
+                            SnapshotHook hook = NULL);
+    boolean registerHandler(byte number, TaskHandler *handler, SnapshotHook hook = NULL);
+    // handler derived from StaticTaskHandler, with its own snapshot hook
+    template<class Handler> boolean registerStaticHandler(byte number, Handler *handler) {
+      return registerHandler(number, Handler::dispatch, handler, Handler::snapshot);
+    }
+    // resource saved as held by its holder, register in same order after reset
+    boolean registerResource(ResourceTrigger *resource);
+
+    // store queued tasks, number of tasks saved
+    byte save();
+    // add saved tasks with times moved to current clock. false if snapshot
+    // is missing, broken or of other version
+    boolean restore();
+    // make stored snapshot invalid, e.g. once restored state is no longer wanted
+    void erase();
+};
+
+extern TaskSnapshot Snapshot;
+
+#endif
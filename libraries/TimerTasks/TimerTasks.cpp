@@ -1,70 +1,418 @@
 #include <TimerTasks.h>
 
+// position on curve is kept in 16 bits, top bits pick segment
+#define CURVE_FRACTION_BITS (16-CURVE_SEGMENT_BITS)
+#define CURVE_FRACTION_MASK ((1<<CURVE_FRACTION_BITS)-1)
+// position of last value, sweep sends endVal there
+#define CURVE_END           (0xFFFF)
+
+// x*x
+const unsigned short CurveEaseIn[CURVE_POINTS] PROGMEM = {
+  0, 128, 512, 1152, 2048, 3200, 4608, 6272, 8192,
+  10368, 12800, 15488, 18432, 21632, 25088, 28800, 32768
+};
+// 1-(1-x)*(1-x)
+const unsigned short CurveEaseOut[CURVE_POINTS] PROGMEM = {
+  0, 3968, 7680, 11136, 14336, 17280, 19968, 22400, 24576,
+  26496, 28160, 29568, 30720, 31616, 32256, 32640, 32768
+};
+// smoothstep, 3*x*x-2*x*x*x
+const unsigned short CurveSCurve[CURVE_POINTS] PROGMEM = {
+  0, 368, 1408, 3024, 5120, 7600, 10368, 13328, 16384,
+  19440, 22400, 25168, 27648, 29744, 31360, 32400, 32768
+};
+// pow(x, 2.2), perceived brightness of leds
+const unsigned short CurveGamma[CURVE_POINTS] PROGMEM = {
+  0, 74, 338, 824, 1552, 2536, 3787, 5316, 7132,
+  9241, 11652, 14370, 17401, 20752, 24427, 28431, 32768
+};
+
 void PeriodicTask::init(void (*aCallback)(Task* task, byte handle, unsigned short value, boolean last)) {
   callback = aCallback;
 }
 
-void PeriodicTask::start(byte id, byte aHandle, unsigned short startVal,
-                         unsigned short anEndVal, short increment, unsigned long aTimeStep) {
-  handle = aHandle;
-  currentVal = startVal;
-  endVal = anEndVal;
-  incrementStep = increment;
-  timeStep = aTimeStep;
-  TM.addTask(id, TIME_TRIGGER, 0, this);
+boolean PeriodicTask::setup(Task *task, byte aHandle, unsigned short startVal,
+                            unsigned short anEndVal, short increment, TaskTime aTimeStep) {
+  State *state = TaskStates.take<State>(task, dispatch, this);
+  if (!state) return false;
+  state->handle = aHandle;
+  state->currentVal = startVal;
+  state->endVal = anEndVal;
+  state->incrementStep = increment;
+  state->timeStep = aTimeStep;
+  state->curve = NULL;
+  return true;
 }
 
-void PeriodicTask::start(Task *task, byte aHandle, unsigned short startVal,
-                         unsigned short anEndVal, short increment, unsigned long aTimeStep) {
-  handle = aHandle;
-  currentVal = startVal;
-  endVal = anEndVal;
-  incrementStep = increment;
-  timeStep = aTimeStep;
+boolean PeriodicTask::setup(Task *task, byte aHandle, unsigned short startVal,
+                            unsigned short anEndVal, unsigned short steps,
+                            TaskTime aTimeStep, const unsigned short *aCurve) {
+  State *state = TaskStates.take<State>(task, dispatch, this);
+  if (!state) return false;
+  if (!steps) steps = 1;
+  state->handle = aHandle;
+  state->startVal = startVal;
+  state->endVal = anEndVal;
+  state->currentVal = 0;
+  // rounded up so last step reaches end, division is done once here
+  state->incrementStep = (CURVE_END+steps-1)/steps;
+  state->timeStep = aTimeStep;
+  state->curve = aCurve;
+  return true;
+}
+
+boolean PeriodicTask::start(byte id, byte aHandle, unsigned short startVal,
+                            unsigned short anEndVal, short increment, TaskTime aTimeStep) {
+  Task *task = TM.addTask(id, TIME_TRIGGER, 0, dispatch, this);
+  if (!task) return false;
+  if (!setup(task, aHandle, startVal, anEndVal, increment, aTimeStep)) {
+    TM.removeTask(id);
+    return false;
+  }
+  return true;
+}
+
+boolean PeriodicTask::start(Task *task, byte aHandle, unsigned short startVal,
+                            unsigned short anEndVal, short increment, TaskTime aTimeStep) {
+  if (!setup(task, aHandle, startVal, anEndVal, increment, aTimeStep)) {
+    task->clear();
+    TM.updateTask(task);
+    return false;
+  }
+  task->trigger = TIME_TRIGGER;
+  task->time = TM.now();
+  task->setFunction(dispatch, this);
+  // refile, a no-op while task runs
+  TM.updateTask(task);
+  return true;
+}
+
+boolean PeriodicTask::start(byte id, byte aHandle, unsigned short startVal,
+                            unsigned short anEndVal, unsigned short steps,
+                            TaskTime aTimeStep, const unsigned short *aCurve) {
+  Task *task = TM.addTask(id, TIME_TRIGGER, 0, dispatch, this);
+  if (!task) return false;
+  if (!setup(task, aHandle, startVal, anEndVal, steps, aTimeStep, aCurve)) {
+    TM.removeTask(id);
+    return false;
+  }
+  return true;
+}
+
+boolean PeriodicTask::start(Task *task, byte aHandle, unsigned short startVal,
+                            unsigned short anEndVal, unsigned short steps,
+                            TaskTime aTimeStep, const unsigned short *aCurve) {
+  if (!setup(task, aHandle, startVal, anEndVal, steps, aTimeStep, aCurve)) {
+    task->clear();
+    TM.updateTask(task);
+    return false;
+  }
   task->trigger = TIME_TRIGGER;
-  task->time = millis();
-  task->handler = this;
+  task->time = TM.now();
+  task->setFunction(dispatch, this);
+  TM.updateTask(task);
+  return true;
 }
 
-void PeriodicTask::doTask(Task *task, byte trigger, unsigned long time) {
+unsigned short PeriodicTask::curveValue(State *state) {
+  unsigned short position = state->currentVal;
+  if (position==CURVE_END) return state->endVal;
+  // straight line between two points of curve, shifts only
+  const unsigned short *point = state->curve + (position>>CURVE_FRACTION_BITS);
+  long from = pgm_read_word(point);
+  long to = pgm_read_word(point+1);
+  long shaped = from + (((to-from)*(position&CURVE_FRACTION_MASK))>>CURVE_FRACTION_BITS);
+  return state->startVal + ((((long)state->endVal-state->startVal)*shaped)>>15);
+}
+
+void PeriodicTask::doTask(Task *task, byte trigger, TaskTime time) {
+  State *state = TaskStates.of<State>(task);
+  // callback could restart task with other state
+  TaskTime timeStep = state->timeStep;
+  missed = 0;
+  TaskTime late = time - task->time;
+  if (timeStep && late>=timeStep) {
+    if (task->overrun==OVERRUN_CATCH_UP) {
+      TM.addOverruns(1);
+    } else {
+      // back on schedule after a stall, divisions are off the regular path
+      TaskTime steps = late/timeStep;
+      task->time += steps*timeStep;
+      missed = steps>0xFFFF ? 0xFFFF : steps;
+      TM.addOverruns(missed);
+      if (task->overrun==OVERRUN_COALESCE && state->curve) {
+        unsigned short step = state->incrementStep;
+        unsigned long left = (CURVE_END-state->currentVal+step-1)/step;
+        if (missed>left) missed = left;
+        unsigned long position = state->currentVal+(unsigned long)step*missed;
+        state->currentVal = position>CURVE_END ? CURVE_END : position;
+      } else if (task->overrun==OVERRUN_COALESCE && state->incrementStep) {
+        // don't step beyond last value of the sweep
+        long left = ((long)state->endVal-state->currentVal)/state->incrementStep;
+        if (left<0) left = 0;
+        if (missed>left) missed = left;
+        // product overflows int of 16 bits
+        state->currentVal += (long)state->incrementStep*missed;
+      }
+    }
+  }
+  if (state->curve) {
+    unsigned short value = curveValue(state);
+    if (state->currentVal==CURVE_END) {
+      task->trigger = 0;
+      callback(task, state->handle, value, true);
+      if (!task->trigger) task->clear();
+      return;
+    }
+    // move along curve, stopping at its end
+    unsigned long position = state->currentVal+(unsigned short)state->incrementStep;
+    state->currentVal = position>CURVE_END ? CURVE_END : position;
+    callback(task, state->handle, value, false);
+    task->time += timeStep;
+    return;
+  }
   // save current value for notification
-  unsigned short value = currentVal;
-  // increase position
-  currentVal += incrementStep;
+  unsigned short value = state->currentVal;
+  // next position in long, so sweeps ending near 0 or 0xFFFF don't wrap
+  long next = (long)value + state->incrementStep;
+  state->currentVal = next;
   // check if next is still in range
-  if (incrementStep>0 && currentVal>endVal || incrementStep<0 && currentVal<endVal) {
+  if ((state->incrementStep>0 && next>state->endVal)
+      || (state->incrementStep<0 && next<state->endVal)) {
     // stop sweep since we overshot
     // reset trigger in case client doesn't clear task correctly,
     // but we still need to preserve id so can't call clear()
     task->trigger = 0;
     // send last response
-    callback(task, handle, value, true);
+    callback(task, state->handle, value, true);
     if (!task->trigger) task->clear(); // callback didn't update we may remove task
   } else {
-    callback(task, handle, value, false);
+    callback(task, state->handle, value, false);
     // increse time for next step
     task->time += timeStep;
   }
 }
 
+unsigned short PeriodicTask::missedSteps() {
+  return missed;
+}
+
+void SweepChannel::set(unsigned short startVal, unsigned short anEndVal, short increment) {
+  value = startVal;
+  endVal = anEndVal;
+  incrementStep = increment;
+}
+
+void SweepTask::init(void (*aCallback)(Task* task, byte handle, SweepChannel *channels, byte count, boolean last)) {
+  callback = aCallback;
+}
+
+boolean SweepTask::setup(Task *task, byte aHandle, SweepChannel *channels, byte count,
+                         TaskTime aTimeStep) {
+  State *state = TaskStates.take<State>(task, dispatch, this);
+  if (!state) return false;
+  state->handle = aHandle;
+  state->channels = channels;
+  state->count = count;
+  state->timeStep = aTimeStep;
+  return true;
+}
+
+boolean SweepTask::start(byte id, byte aHandle, SweepChannel *channels, byte count,
+                         TaskTime aTimeStep) {
+  Task *task = TM.addTask(id, TIME_TRIGGER, 0, dispatch, this);
+  if (!task) return false;
+  if (!setup(task, aHandle, channels, count, aTimeStep)) {
+    TM.removeTask(id);
+    return false;
+  }
+  return true;
+}
+
+boolean SweepTask::start(Task *task, byte aHandle, SweepChannel *channels, byte count,
+                         TaskTime aTimeStep) {
+  if (!setup(task, aHandle, channels, count, aTimeStep)) {
+    task->clear();
+    TM.updateTask(task);
+    return false;
+  }
+  task->trigger = TIME_TRIGGER;
+  task->time = TM.now();
+  task->setFunction(dispatch, this);
+  TM.updateTask(task);
+  return true;
+}
+
+boolean SweepTask::advance(SweepChannel *channel, byte count, unsigned short steps) {
+  boolean done = true;
+  for(;count;count--,channel++) {
+    if (channel->value==channel->endVal) continue;
+    long next = channel->value + (long)channel->incrementStep*steps;
+    // stop on end instead of overshooting it
+    if ((channel->incrementStep>0 && next>=channel->endVal)
+        || (channel->incrementStep<0 && next<=channel->endVal)) {
+      next = channel->endVal;
+    } else {
+      done = false;
+    }
+    channel->value = next;
+  }
+  return done;
+}
+
+void SweepTask::doTask(Task *task, byte trigger, TaskTime time) {
+  State *state = TaskStates.of<State>(task);
+  // callback could restart task with other state
+  TaskTime timeStep = state->timeStep;
+  SweepChannel *channels = state->channels;
+  byte count = state->count;
+  TaskTime late = time - task->time;
+  if (timeStep && late>=timeStep) {
+    if (task->overrun==OVERRUN_CATCH_UP) {
+      TM.addOverruns(1);
+    } else {
+      // one realignment for all channels keeps them in phase
+      TaskTime steps = late/timeStep;
+      task->time += steps*timeStep;
+      unsigned short missed = steps>0xFFFF ? 0xFFFF : steps;
+      TM.addOverruns(missed);
+      if (task->overrun==OVERRUN_COALESCE) advance(channels, count, missed);
+    }
+  }
+  byte i;
+  boolean last = true;
+  for(i=0;i<count;i++) {
+    if (channels[i].value!=channels[i].endVal) last = false;
+  }
+  if (last) {
+    task->trigger = 0;
+    callback(task, state->handle, channels, count, true);
+    if (!task->trigger) task->clear(); // callback didn't update we may remove task
+    return;
+  }
+  callback(task, state->handle, channels, count, false);
+  // values were sent, step unless callback started other channels
+  if (state->channels==channels) advance(channels, count, 1);
+  task->time += timeStep;
+}
+
+// Timer::entry of one shot timers
+#define NO_REPEAT (0xFF)
+
 void TimerTask::init(void (*aCallback)(Task* task, byte handle)) {
   callback = aCallback;
 }
 
-void TimerTask::start(byte id, byte aHandle, unsigned long invocationDelay) {
-  handle = aHandle;
-  TM.addTask(id, TIME_TRIGGER, invocationDelay, this);
+boolean TimerTask::setup(Task *task, byte aHandle, TaskTime aPeriod, unsigned short aCount) {
+  if (!aPeriod || aCount==1) {
+    Timer *timer = task->state<Timer>();
+    timer->entry = NO_REPEAT;
+    timer->handle = aHandle;
+    return true;
+  }
+  State *state = TaskStates.take<State>(task, dispatch, this);
+  if (!state) return false;
+  // take set entry
+  task->state<Timer>()->handle = aHandle;
+  memset(&state->stats, 0, sizeof(TimerStats));
+  state->period = aPeriod;
+  state->count = aCount;
+  return true;
+}
+
+boolean TimerTask::start(byte id, byte aHandle, TaskTime invocationDelay) {
+  return start(id, aHandle, invocationDelay, 0, 1);
 }
 
-void TimerTask::start(Task *task, byte aHandle, unsigned long invocationDelay) {
-  handle = aHandle;
+boolean TimerTask::start(Task *task, byte aHandle, TaskTime invocationDelay) {
+  return start(task, aHandle, invocationDelay, 0, 1);
+}
+
+boolean TimerTask::start(byte id, byte aHandle, TaskTime invocationDelay, unsigned short slack) {
+  Task *task = TM.addTask(id, TIME_TRIGGER, invocationDelay, dispatch, this);
+  if (!task) return false;
+  setup(task, aHandle, 0, 1);
+  TM.setSlack(task, slack);
+  return true;
+}
+
+boolean TimerTask::start(Task *task, byte aHandle, TaskTime invocationDelay, unsigned short slack) {
+  start(task, aHandle, invocationDelay);
+  // refiled when loop ends, if called from doTask
+  task->slack = slack;
+  TM.updateTask(task);
+  return true;
+}
+
+boolean TimerTask::start(byte id, byte aHandle, TaskTime invocationDelay,
+                         TaskTime aPeriod, unsigned short aCount) {
+  Task *task = TM.addTask(id, TIME_TRIGGER, invocationDelay, dispatch, this);
+  if (!task) return false;
+  if (!setup(task, aHandle, aPeriod, aCount)) {
+    TM.removeTask(id);
+    return false;
+  }
+  return true;
+}
+
+boolean TimerTask::start(Task *task, byte aHandle, TaskTime invocationDelay,
+                         TaskTime aPeriod, unsigned short aCount) {
+  if (!setup(task, aHandle, aPeriod, aCount)) {
+    task->clear();
+    TM.updateTask(task);
+    return false;
+  }
   task->trigger = TIME_TRIGGER;
-  task->time = millis()+invocationDelay;
-  task->handler = this;
+  task->time = TM.now()+invocationDelay;
+  task->setFunction(dispatch, this);
+  TM.updateTask(task);
+  return true;
 }
 
-void TimerTask::doTask(Task *task, byte trigger, unsigned long time) {
-  task->trigger = 0;
-  callback(task, handle);
-  if (!task->trigger) task->clear(); // callback didn't update we may remove task
+unsigned short TimerTask::remaining(Task *task) {
+  if (task->state<Timer>()->entry==NO_REPEAT) return 0;
+  return TaskStates.of<State>(task)->count;
 }
+
+TimerStats* TimerTask::stats(Task *task) {
+  if (task->state<Timer>()->entry==NO_REPEAT) return NULL;
+  return &TaskStates.of<State>(task)->stats;
+}
+
+void TimerTask::doTask(Task *task, byte trigger, TaskTime time) {
+  Timer *timer = task->state<Timer>();
+  if (timer->entry==NO_REPEAT) {
+    task->trigger = 0;
+    callback(task, timer->handle);
+    if (!task->trigger) task->clear(); // callback didn't update we may remove task
+    return;
+  }
+  State *state = TaskStates.of<State>(task);
+  TaskTime late = time - task->time;
+  TimerStats *stats = &state->stats;
+  stats->runs++;
+  stats->totalLate += late;
+  if (late>stats->maxLate) stats->maxLate = late>0xFFFF ? 0xFFFF : late;
+  if (state->count<=1) {
+    task->trigger = 0;
+    state->count = 0;
+    callback(task, timer->handle);
+    if (!task->trigger) task->clear(); // callback didn't update we may remove task
+    return;
+  }
+  if (state->count!=TIMER_FOREVER) state->count--;
+  // next run from due time, not from now
+  task->time += state->period;
+  if (late>=state->period) {
+    if (task->overrun==OVERRUN_CATCH_UP) {
+      TM.addOverruns(1);
+    } else {
+      // drop runs that are already past, phase is kept
+      TaskTime steps = late/state->period;
+      task->time += steps*state->period;
+      TM.addOverruns(steps>0xFFFF ? 0xFFFF : steps);
+    }
+  }
+  callback(task, timer->handle);
+}
+
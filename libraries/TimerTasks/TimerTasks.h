@@ -4,34 +4,148 @@
 #include <Arduino.h>
 #include <TaskManager.h>
 
-class PeriodicTask : public TaskHandler {
+// sweep curves, CURVE_POINTS values in PROGMEM going from 0 to CURVE_SCALE,
+// straight lines are drawn between points. own curves follow same layout
+#define CURVE_SEGMENT_BITS (4)
+#define CURVE_POINTS       ((1<<CURVE_SEGMENT_BITS)+1)
+#define CURVE_SCALE        (0x8000)
+
+extern const unsigned short CurveEaseIn[CURVE_POINTS];
+extern const unsigned short CurveEaseOut[CURVE_POINTS];
+extern const unsigned short CurveSCurve[CURVE_POINTS];
+extern const unsigned short CurveGamma[CURVE_POINTS];
+
+// sweep state is kept in TaskStates, each running sweep takes an entry.
+// start fails when they are all taken
+class PeriodicTask : public StaticTaskHandler<PeriodicTask> {
+  struct State {
+    TaskTime timeStep;
+    unsigned short currentVal;
+    unsigned short endVal;
+    short incrementStep;
+    byte handle;
+    // curve sweeps only, currentVal is position on curve then
+    const unsigned short *curve;
+    unsigned short startVal;
+  };
+
   void (*callback)(Task* task, byte handle, unsigned short value, boolean last);
-  
-  byte handle;
-  unsigned short currentVal;
+  // steps skipped or merged in current call, see Task::overrun
+  unsigned short missed;
+
+  // false if TaskStates are all taken
+  boolean setup(Task *task, byte handle, unsigned short startVal, unsigned short endVal,
+                short increment, TaskTime timeStep);
+  boolean setup(Task *task, byte handle, unsigned short startVal, unsigned short endVal,
+                unsigned short steps, TaskTime timeStep, const unsigned short *curve);
+  unsigned short curveValue(State *state);
+
+  public:
+    void init(void (*callback)(Task* task, byte handle, unsigned short value, boolean last));
+    boolean start(byte id, byte handle, unsigned short startVal, unsigned short endVal, 
+                  short increment, TaskTime timeStep);
+    boolean start(Task *task, byte handle, unsigned short startVal, unsigned short endVal, 
+                  short increment, TaskTime timeStep);
+    // sweep from startVal to endVal shaped by curve, e.g. CurveEaseIn, in
+    // about steps steps. startVal is sent first and endVal last
+    boolean start(byte id, byte handle, unsigned short startVal, unsigned short endVal,
+                  unsigned short steps, TaskTime timeStep, const unsigned short *curve);
+    boolean start(Task *task, byte handle, unsigned short startVal, unsigned short endVal,
+                  unsigned short steps, TaskTime timeStep, const unsigned short *curve);
+    void doTask(Task *task, byte trigger, TaskTime time);
+    // steps missed before value passed to callback, 0 unless task ran a
+    // period or more late with OVERRUN_SKIP or OVERRUN_COALESCE
+    unsigned short missedSteps();
+};
+
+// one channel of SweepTask, value is what callback gets this step
+struct SweepChannel {
+  unsigned short value;
   unsigned short endVal;
   short incrementStep;
-  unsigned long timeStep;
+
+  // value moves by increment each step and stays at endVal once reached
+  void set(unsigned short startVal, unsigned short endVal, short increment);
+};
+
+// sweeps several channels in lockstep with one task, e.g. servos moving
+// together. all values of a step come in one callback, last is set once
+// every channel reached its end. channels are kept by caller, group state
+// takes an entry of TaskStates
+class SweepTask : public StaticTaskHandler<SweepTask> {
+  struct State {
+    SweepChannel *channels;
+    TaskTime timeStep;
+    byte count;
+    byte handle;
+  };
+
+  void (*callback)(Task* task, byte handle, SweepChannel *channels, byte count, boolean last);
+
+  // false if TaskStates are all taken
+  boolean setup(Task *task, byte handle, SweepChannel *channels, byte count, TaskTime timeStep);
+  // move all channels steps ahead, true if they are all at end
+  static boolean advance(SweepChannel *channels, byte count, unsigned short steps);
 
   public:
-    void init(void (*callback)(Task* task, byte handle, unsigned short value, boolean last));
-    void start(byte id, byte handle, unsigned short startVal, unsigned short endVal, 
-               short increment, unsigned long timeStep);
-    void start(Task *task, byte handle, unsigned short startVal, unsigned short endVal, 
-               short increment, unsigned long timeStep);
-    virtual void doTask(Task *task, byte trigger, unsigned long time);
+    void init(void (*callback)(Task* task, byte handle, SweepChannel *channels, byte count, boolean last));
+    boolean start(byte id, byte handle, SweepChannel *channels, byte count, TaskTime timeStep);
+    boolean start(Task *task, byte handle, SweepChannel *channels, byte count, TaskTime timeStep);
+    void doTask(Task *task, byte trigger, TaskTime time);
 };
 
-class TimerTask : public TaskHandler {
+// repeat count of timer that runs until it is cleared
+#define TIMER_FOREVER (0xFFFF)
+
+// lateness of a repeating timer's runs, in clock ticks
+struct TimerStats {
+  unsigned short runs;
+  unsigned short maxLate;
+  unsigned long totalLate;
+};
+
+// handle is kept in task, one object serves any number of one shot timers.
+// repeating ones take an entry of TaskStates each
+class TimerTask : public StaticTaskHandler<TimerTask> {
+  // task state, entry is NO_REPEAT for one shot timers
+  struct Timer {
+    byte entry;
+    byte handle;
+  };
+  struct State {
+    TaskTime period;
+    TimerStats stats;
+    // runs left, TIMER_FOREVER for no limit
+    unsigned short count;
+  };
+
   void (*callback)(Task* task, byte handle);
-  
-  byte handle;
+
+  // false if timer repeats and TaskStates are all taken
+  boolean setup(Task *task, byte handle, TaskTime period, unsigned short count);
 
   public:
     void init(void (*callback)(Task* task, byte handle));
-    void start(byte id, byte handle, unsigned long invocationDelay);
-    void start(Task *task, byte handle, unsigned long invocationDelay);
-    virtual void doTask(Task *task, byte trigger, unsigned long time);
+    // start returns false if task couldn't be added or state has no room
+    boolean start(byte id, byte handle, TaskTime invocationDelay);
+    boolean start(Task *task, byte handle, TaskTime invocationDelay);
+    // timer could fire up to slack ticks late, so timers of loose deadlines
+    // share wakeups, see TaskManager::setSlack. slack is capped at 65535
+    // ticks, which is 65 ms with TASK_MICROS
+    boolean start(byte id, byte handle, TaskTime invocationDelay, unsigned short slack);
+    boolean start(Task *task, byte handle, TaskTime invocationDelay, unsigned short slack);
+    // run count times, period apart after first run. next run is set from
+    // previous due time, so timer doesn't drift by callback run time. clear
+    // task in callback to stop early
+    boolean start(byte id, byte handle, TaskTime invocationDelay, TaskTime period,
+                  unsigned short count);
+    boolean start(Task *task, byte handle, TaskTime invocationDelay, TaskTime period,
+                  unsigned short count);
+    // runs left after current one, TIMER_FOREVER if unlimited
+    unsigned short remaining(Task *task);
+    // NULL for one shot timers
+    TimerStats* stats(Task *task);
+    void doTask(Task *task, byte trigger, TaskTime time);
 };
 
-#endif
\ No newline at end of file
+#endif
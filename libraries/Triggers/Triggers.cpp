@@ -4,6 +4,9 @@ void ResourceTrigger::init(byte tag) {
   resourceTag  =  tag;
   resourceMask = ~tag;
   status = false;
+  holderId = 0;
+  // status only moves in aquire and release
+  tracked = true;
   TM.registerTrigger(this);
 }
 
@@ -16,11 +19,30 @@ byte ResourceTrigger::trigger() {
 }
 
 void ResourceTrigger::aquire() {
+  Task *task = TM.runningTask();
+  aquire(task ? task->id : 0);
+}
+
+void ResourceTrigger::aquire(byte holder) {
   status = true;
+  holderId = holder;
+  changed();
+#ifdef TASK_TRACE
+  taskTrace(TRACE_AQUIRE, resourceTag);
+#endif
 }
     
 void ResourceTrigger::release() {
   status = false;
+  holderId = 0;
+  changed();
+#ifdef TASK_TRACE
+  taskTrace(TRACE_RELEASE, resourceTag);
+#endif
+}
+
+byte ResourceTrigger::holder() {
+  return status ? holderId : 0;
 }
 
 byte ResourceTrigger::setTrigger(byte event) {
@@ -45,12 +67,172 @@ void CaptureResource::init(ResourceTrigger *aTrigger, void (*aCallback)(Task *ta
 }
 
 void CaptureResource::start(byte id, byte aHandle) {
-  handle = aHandle;
-  TM.addTask(id, trigger->trigger(), this);
+  Task *task = TM.addTask(id, trigger->trigger(), dispatch, this);
+  if (task) *task->state<byte>() = aHandle;
 }
 
-void CaptureResource::doTask(Task *task, byte trigger, unsigned long time) {
+void CaptureResource::doTask(Task *task, byte trigger, TaskTime time) {
   task->trigger = 0;
-  callback(task, handle);
+  callback(task, *task->state<byte>());
   if (!task->trigger) task->clear(); // callback didn't reuse we may remove task  
 }
+
+void SemaphoreTrigger::init(byte tag, byte aPermits) {
+  resourceTag  =  tag;
+  resourceMask = ~tag;
+  permits = aPermits;
+  first = 0;
+  waiting = 0;
+  nextTicket = 0;
+  tracked = true;
+  TM.registerTrigger(this);
+}
+
+boolean SemaphoreTrigger::isOn() {
+  return permits>0;
+}
+
+byte SemaphoreTrigger::trigger() {
+  return resourceTag;
+}
+
+byte SemaphoreTrigger::available() {
+  return permits;
+}
+
+boolean SemaphoreTrigger::tryAquire() {
+  prune();
+  // no cutting in line
+  if (!permits || waiting) return false;
+  permits--;
+  changed();
+#ifdef TASK_TRACE
+  taskTrace(TRACE_AQUIRE, resourceTag);
+#endif
+  return true;
+}
+
+void SemaphoreTrigger::release() {
+  permits++;
+  changed();
+  // removed first waiter must not hold up the one behind it
+  prune();
+#ifdef TASK_TRACE
+  taskTrace(TRACE_RELEASE, resourceTag);
+#endif
+}
+
+boolean SemaphoreTrigger::enqueue(Task *task) {
+  prune();
+  if (waiting>=SEMAPHORE_WAITERS) return false;
+  Waiter *waiter = waiters+(first+waiting)%SEMAPHORE_WAITERS;
+  waiter->id = task->id;
+  waiter->ticket = nextTicket++;
+  *task->state<unsigned short>() = waiter->ticket;
+  if (waiting) {
+    park(task);
+  } else {
+    task->trigger = resourceTag;
+    TM.updateTask(task);
+  }
+  waiting++;
+  return true;
+}
+
+void SemaphoreTrigger::park(Task *task) {
+  task->trigger = resourceTag | TIME_TRIGGER;
+  task->time = TM.now() + SEMAPHORE_RECHECK;
+  TM.updateTask(task);
+}
+
+boolean SemaphoreTrigger::waits(Waiter *waiter) {
+  Task *task = TM.findTask(waiter->id);
+  // removed, or id taken by task of other handler or semaphore
+  if (!task || task->function!=CaptureSemaphore::dispatch) return false;
+  if (((CaptureSemaphore*)task->context)->semaphore!=this) return false;
+  // started waiting again or moved on to other trigger
+  return (task->trigger & resourceTag) && *task->state<unsigned short>()==waiter->ticket;
+}
+
+void SemaphoreTrigger::prune() {
+  while (waiting && !waits(waiters+first)) {
+    first = (first+1)%SEMAPHORE_WAITERS;
+    waiting--;
+  }
+  if (!waiting) return;
+  Task *task = TM.findTask(waiters[first].id);
+  if (task->trigger!=resourceTag) {
+    task->trigger = resourceTag;
+    TM.updateTask(task);
+  }
+}
+
+boolean SemaphoreTrigger::handoff(Task *task) {
+  prune();
+  if (!waiting || waiters[first].id!=task->id) {
+    park(task);
+    return false;
+  }
+  if (!permits) return false;
+  first = (first+1)%SEMAPHORE_WAITERS;
+  waiting--;
+  permits--;
+  changed();
+  prune();
+#ifdef TASK_TRACE
+  taskTrace(TRACE_AQUIRE, resourceTag);
+#endif
+  return true;
+}
+
+byte SemaphoreTrigger::setTrigger(byte event) {
+  if (permits) {
+    event |= resourceTag;
+  }
+  return event;
+}
+
+byte SemaphoreTrigger::updateTrigger(byte event) {
+  if (permits) {
+    event |= resourceTag;
+  } else {
+    event &= resourceMask;
+  }
+  return event;
+}
+
+void CaptureSemaphore::init(SemaphoreTrigger *aSemaphore, void (*aCallback)(Task *task, byte handle)) {
+  semaphore = aSemaphore;
+  callback = aCallback;
+}
+
+boolean CaptureSemaphore::start(byte id, byte aHandle) {
+  Task *task = TM.addTask(id, semaphore->trigger(), dispatch, this);
+  if (!task) return false;
+  task->state<Wait>()->handle = aHandle;
+  if (semaphore->enqueue(task)) return true;
+  TM.removeTask(id);
+  return false;
+}
+
+boolean CaptureSemaphore::start(Task *task, byte aHandle) {
+  if (!semaphore->enqueue(task)) return false;
+  task->state<Wait>()->handle = aHandle;
+  task->setFunction(dispatch, this);
+  return true;
+}
+
+void CaptureSemaphore::doTask(Task *task, byte trigger, TaskTime time) {
+  // not first in line, keep waiting
+  if (!semaphore->handoff(task)) return;
+  task->trigger = 0;
+  callback(task, task->state<Wait>()->handle);
+  if (!task->trigger) task->clear(); // callback didn't reuse we may remove task
+}
+
+boolean CaptureSemaphore::snapshot(Task *task, boolean restored) {
+  if (!restored) return true;
+  // place in line is not saved, ticket of old line means nothing
+  CaptureSemaphore *capture = (CaptureSemaphore*)task->context;
+  return capture->semaphore->enqueue(task);
+}
@@ -8,13 +8,19 @@ class ResourceTrigger : public Trigger {
   byte resourceTag;
   byte resourceMask;
   boolean status;
+  // id of task that aquired resource, 0 outside of tasks
+  byte holderId;
 
   public:
     // init trigger and set resource tag
     void init(byte tag);
-    // update trigger status
+    // update trigger status, running task becomes holder
     void aquire();
+    // aquire for task id, e.g. when its state is restored
+    void aquire(byte holder);
     void release();
+    // id of task that holds resource, 0 if it is free or held outside of tasks
+    byte holder();
     // is trigger on
     virtual boolean isOn();
     // get trigger associated with this resource
@@ -25,15 +31,102 @@ class ResourceTrigger : public Trigger {
     virtual byte updateTrigger(byte event);
 };
 
-class CaptureResource : public TaskHandler {
+// handle is kept in task, one object serves all tasks waiting for trigger
+class CaptureResource : public StaticTaskHandler<CaptureResource> {
   ResourceTrigger *trigger;
-  byte handle;
   void (*callback)(Task *task, byte handle);
 
   public:
     void init(ResourceTrigger *trigger, void (*callback)(Task *task, byte handle));
     void start(byte id, byte handle);
-    virtual void doTask(Task *task, byte trigger, unsigned long time);
+    void doTask(Task *task, byte trigger, TaskTime time);
+};
+
+// tasks that could wait in line for one semaphore
+#ifndef SEMAPHORE_WAITERS
+#define SEMAPHORE_WAITERS (8)
+#endif
+
+// parked waiters look at line this often anyway, in case its first task
+// was removed while nothing else moved the line
+#ifndef SEMAPHORE_RECHECK
+#define SEMAPHORE_RECHECK TASK_MS(1000)
+#endif
+
+// counting semaphore, trigger is on while any of its permits is free.
+// waiting CaptureSemaphore tasks get permits in order they started
+// waiting, whatever their slot or priority is. only first waiter waits for
+// trigger, others are parked on a timer until they are first
+class SemaphoreTrigger : public Trigger {
+  struct Waiter {
+    byte id;
+    // matches task state while task still waits for this place in line
+    unsigned short ticket;
+  };
+
+  byte resourceTag;
+  byte resourceMask;
+  byte permits;
+  // waiting tasks, oldest at first
+  Waiter waiters[SEMAPHORE_WAITERS];
+  byte first;
+  byte waiting;
+  unsigned short nextTicket;
+
+  // task of waiter still waits for its place, id could be reused meanwhile
+  boolean waits(Waiter *waiter);
+  // drop first waiters that no longer wait, first one left waits for trigger
+  void prune();
+  // keep task from running until it is first or SEMAPHORE_RECHECK passed
+  void park(Task *task);
+
+  public:
+    // init trigger with tag and number of holders it allows at once
+    void init(byte tag, byte permits);
+    // take permit if one is free and no task waits in line
+    boolean tryAquire();
+    void release();
+    // free permits
+    byte available();
+    // put CaptureSemaphore task in line, its ticket goes to first bytes of
+    // its state and its trigger is set. false if line is full
+    boolean enqueue(Task *task);
+    // take permit for task if it is first in line and one is free. task
+    // not first is parked again
+    boolean handoff(Task *task);
+    // is trigger on
+    virtual boolean isOn();
+    // get trigger associated with this semaphore
+    virtual byte trigger();
+    // set trigger at the beginning of loop
+    virtual byte setTrigger(byte event);
+    // update trigger after each task
+    virtual byte updateTrigger(byte event);
+};
+
+// handle is kept in task, callback runs holding one permit of semaphore and
+// must release it
+class CaptureSemaphore : public StaticTaskHandler<CaptureSemaphore> {
+  friend class SemaphoreTrigger;
+
+  // task state, ticket first as SemaphoreTrigger::enqueue sets it
+  struct Wait {
+    unsigned short ticket;
+    byte handle;
+  };
+
+  SemaphoreTrigger *semaphore;
+  void (*callback)(Task *task, byte handle);
+
+  public:
+    void init(SemaphoreTrigger *semaphore, void (*callback)(Task *task, byte handle));
+    // false if task could not be added or line is full
+    boolean start(byte id, byte handle);
+    // wait again, e.g. from callback
+    boolean start(Task *task, byte handle);
+    void doTask(Task *task, byte trigger, TaskTime time);
+    // restored tasks wait in line again, in order they are restored
+    static boolean snapshot(Task *task, boolean restored);
 };
 
 #endif